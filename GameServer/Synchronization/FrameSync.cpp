@@ -1,15 +1,35 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
 #include <iostream>
 #include <vector>
 #include <thread>
 #include <chrono>
-#include <mutex>
-#include <unordered_map>
-#include <queue>
+#include <atomic>
+
+#include "frame_scheduler.h"
+#include "input_protocol.h"
+#include "frame_packet.h"
+#include "game_sim.h"
+#include "replay_log.h"
+#include "room_scheduler.h"
 
-class FrameSyncServer
+#define MAX_PLAYERS 64
+#define REDUNDANT_FRAMES 4  // 每个广播包携带最近几帧的输入
+
+class FrameSyncServer : public Room
 {
 public:
-    FrameSyncServer(int fps) : fps(fps), frame_duration(1000 / fps), current_frame(0) {}
+    FrameSyncServer(int fps, FrameScheduler::OverrunPolicy policy = FrameScheduler::OverrunPolicy::CatchUp)
+        : fps(fps), current_frame(0), scheduler(fps, policy), udpfd(socket(PF_INET, SOCK_DGRAM, 0)), broadcaster(udpfd) {}
+
+    ~FrameSyncServer()
+    {
+        stop();
+        close(udpfd);
+    }
 
     void start()
     {
@@ -26,77 +46,188 @@ public:
         }
     }
 
-    void receiveInput(int player_id, const std::string &input)
+    // 作为房间挂到 RoomScheduler 上运行时代替 start()/stop()，由调度器按帧率调用
+    void tick() override
     {
-        std::lock_guard<std::mutex> lock(input_mutex);
-        input_queue[player_id].push(input);
+        runFrame();
+    }
+
+    // 帧调度的抖动和超时统计，需在 stop() 之后调用
+    void report(std::ostream &os) const
+    {
+        scheduler.report(os);
+    }
+
+    // 登记接收帧广播的客户端，需在 start() 之前调用
+    void addUdpClient(const sockaddr_in &addr)
+    {
+        broadcaster.addUdpClient(addr);
+    }
+
+    void addTcpClient(int fd)
+    {
+        broadcaster.addTcpClient(fd);
+    }
+
+    // 把每帧的输入和状态校验和追加到录像文件，需在 start() 之前调用
+    bool enableRecording(const char *path)
+    {
+        return recorder.open(path, fps, MAX_PLAYERS);
+    }
+
+    // 玩家加入时登记，之后该玩家的输入由同一个网络线程投递
+    bool addPlayer(int player_id)
+    {
+        return input_queues.addPlayer(player_id);
+    }
+
+    // 网络线程调用：wait-free 地写入该玩家的 SPSC 队列，不与帧线程竞争任何锁
+    // 操作码未知的输入不会进入帧，也就不会广播给客户端；队列已满时返回 false
+    bool receiveInput(int player_id, const InputCmd &cmd)
+    {
+        if (cmd.op >= OP_COUNT)
+        {
+            return false;
+        }
+        return input_queues.push(player_id, cmd);
+    }
+
+    // 网络线程调用：解码一个二进制输入包（见 input_protocol.h），批量投递其中的所有输入
+    // 返回实际投递的条数（队列满时丢弃的不计），包格式错误时返回 -1
+    int receiveInputs(int player_id, const uint8_t *data, size_t len)
+    {
+        int pushed = 0;
+        int decoded = decodeInputPacket(data, len, [this, player_id, &pushed](const InputCmd &cmd)
+        {
+            pushed += receiveInput(player_id, cmd);
+        });
+        return decoded < 0 ? -1 : pushed;
     }
 
 private:
     void run()
     {
+        // 按绝对截止时间调度，超时的帧按策略补跑或丢弃
+        scheduler.start();
         while (running)
         {
-            auto start_time = std::chrono::steady_clock::now();
-
-            // Process inputs
-            std::lock_guard<std::mutex> lock(input_mutex);
-            for (const auto &player : input_queue)
+            int frames = scheduler.waitNextFrame();
+            for (int i = 0; i < frames && running; ++i)
             {
-                // 将每个玩家的输入应用到游戏状态
-                std::cout << "Processing input for player " << player.first << " on frame " << current_frame << std::endl;
-                while (!input_queue[player.first].empty())
-                {
-                    std::string input = input_queue[player.first].front();
-                    input_queue[player.first].pop();
-                    // 处理输入
-                }
+                runFrame();
             }
+        }
+    }
+
+    void runFrame()
+    {
+        // Process inputs：取空每个玩家的队列，整个帧内不持有任何全局锁
+        // 本帧的所有输入收集到 frame_inputs，随后打包广播
+        input_queues.drainAll([this](int player_id, const InputCmd &cmd)
+        {
+            // 将每个玩家的输入应用到游戏状态
+            std::cout << "Processing input " << cmd.op << " for player " << player_id << " on frame " << current_frame << std::endl;
+            frame_inputs.push_back(FrameInput{static_cast<uint16_t>(player_id), cmd});
+        });
 
-            // 更新游戏状态
-            updateGameState();
+        // 更新游戏状态
+        updateGameState();
 
-            // 广播游戏状态
-            broadcastGameState();
+        // 广播游戏状态
+        broadcastGameState();
 
-            current_frame++;
-            auto end_time = std::chrono::steady_clock::now();
-            std::this_thread::sleep_for(std::chrono::milliseconds(frame_duration) - (end_time - start_time));
-        }
+        current_frame++;
     }
 
     void updateGameState()
     {
-        // 在此更新游戏逻辑
-        std::cout << "Updating game state for frame " << current_frame << std::endl;
+        // drainAll 按玩家 id 升序取输入，回放时按录像中的相同顺序应用，结果完全一致
+        for (const FrameInput &in : frame_inputs)
+        {
+            simulation.apply(in.player, in.cmd);
+        }
+        simulation.step();
+        if (recorder.isOpen())
+        {
+            recorder.append(current_frame, frame_inputs, simulation.checksum());
+        }
     }
 
     void broadcastGameState()
     {
-        // 在此广播游戏状态给所有客户端
-        std::cout << "Broadcasting game state for frame " << current_frame << std::endl;
+        // 本帧输入只编码一次（附带最近几帧作为冗余），然后逐个客户端发送同一个包
+        const std::vector<uint8_t> &packet = encoder.encode(current_frame, frame_inputs);
+        broadcaster.broadcast(packet);
+        frame_inputs.clear();
     }
 
     int fps;
-    int frame_duration;
-    int current_frame;
-    bool running = false;
+    std::atomic<int> current_frame;
+    std::atomic<bool> running{false};
+    FrameScheduler scheduler;
     std::thread server_thread;
-    std::unordered_map<int, std::queue<std::string>> input_queue;
-    std::mutex input_mutex;
+    PlayerInputQueues<MAX_PLAYERS> input_queues;
+    std::vector<FrameInput> frame_inputs;
+    FramePacketEncoder<REDUNDANT_FRAMES> encoder;
+    FrameSimulation simulation;
+    ReplayWriter recorder;
+    int udpfd;
+    FrameBroadcaster broadcaster;
 };
 
 int main()
 {
+    // 本地 UDP socket 模拟一个客户端
+    int clientfd = socket(PF_INET, SOCK_DGRAM, 0);
+    sockaddr_in client_addr = {};
+    client_addr.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &client_addr.sin_addr);
+    bind(clientfd, reinterpret_cast<sockaddr *>(&client_addr), sizeof(client_addr));
+    socklen_t addr_len = sizeof(client_addr);
+    getsockname(clientfd, reinterpret_cast<sockaddr *>(&client_addr), &addr_len);
+
     FrameSyncServer server(60); // 60 FPS
+    server.addUdpClient(client_addr);
+    server.addPlayer(1);
+    server.addPlayer(2);
+    server.enableRecording("framesync.replay"); // 可用 replay_bench 回放校验
     server.start();
 
     // 模拟玩家输入
-    server.receiveInput(1, "MoveUp");
-    server.receiveInput(2, "MoveDown");
+    InputPacketWriter writer;
+    writer.add(OP_MOVE_UP);
+    server.receiveInputs(1, writer.data(), writer.size());
+    writer.reset(0);
+    writer.add(OP_MOVE_DOWN);
+    writer.add(OP_MOVE_DIR, -1, 2);
+    server.receiveInputs(2, writer.data(), writer.size());
 
     std::this_thread::sleep_for(std::chrono::seconds(1));
     server.stop();
+    server.report(std::cout);
+
+    // 客户端解码收到的包，人为丢掉每 3 个包中的 1 个，冗余帧会把丢失的输入补齐
+    FramePacketDecoder decoder;
+    static uint8_t buf[FRAME_PACKET_MAX_DATAGRAM];
+    int packets = 0;
+    ssize_t len;
+    while ((len = recv(clientfd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+        if (packets++ % 3 == 1)
+        {
+            continue;
+        }
+        decoder.decode(buf, len, [](uint32_t frame, const std::vector<FrameInput> &inputs)
+        {
+            for (const FrameInput &in : inputs)
+            {
+                std::cout << "client applies input " << in.cmd.op << " of player " << in.player << " on frame " << frame << std::endl;
+            }
+        });
+    }
+    std::cout << "client received " << packets << " packets, applied up to frame " << decoder.nextFrame()
+              << ", lost " << decoder.lost() << " frames" << std::endl;
+    close(clientfd);
 
     return 0;
 }
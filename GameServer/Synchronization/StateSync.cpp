@@ -3,6 +3,24 @@
 #include <thread>
 #include <chrono>
 #include <mutex>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+
+#include "snapshot.h"
+#include "aoi_grid.h"
+#include "input_protocol.h"
+#include "triple_buffer.h"
+#include "frame_scheduler.h"
+#include "room_scheduler.h"
+
+#define INTEREST_RADIUS 50  // 兴趣区域半边长：只同步 x、y 方向距离都不超过该值的玩家
+#define WORLD_MIN -2048     // AOI 网格覆盖的世界范围，超出范围的玩家归入边界格子
+#define WORLD_SIZE 4096
+#define MAX_PLAYERS 64
+#define SIMULATION_FPS 20   // 模拟线程处理输入、发布状态的频率
+#define BROADCAST_FPS 10    // 广播线程发送快照的频率
 
 struct GameState
 {
@@ -11,13 +29,68 @@ struct GameState
     // 其他游戏状态变量
 };
 
-class StateSyncServer
+// 按操作码查表应用输入，代替逐个比较输入字符串
+typedef void (*ApplyInputFn)(GameState &state, const InputCmd &cmd);
+
+static void applyNone(GameState &, const InputCmd &) {}
+static void applyMoveUp(GameState &state, const InputCmd &) { state.player_position_y++; }
+static void applyMoveDown(GameState &state, const InputCmd &) { state.player_position_y--; }
+static void applyMoveLeft(GameState &state, const InputCmd &) { state.player_position_x--; }
+static void applyMoveRight(GameState &state, const InputCmd &) { state.player_position_x++; }
+static void applyMoveDir(GameState &state, const InputCmd &cmd)
+{
+    state.player_position_x += cmd.arg0;
+    state.player_position_y += cmd.arg1;
+}
+
+static const ApplyInputFn g_apply_input[OP_COUNT] = {
+    applyNone,          // OP_NONE
+    applyMoveUp,        // OP_MOVE_UP
+    applyMoveDown,      // OP_MOVE_DOWN
+    applyMoveLeft,      // OP_MOVE_LEFT
+    applyMoveRight,     // OP_MOVE_RIGHT
+    applyMoveDir,       // OP_MOVE_DIR
+    applyNone,          // OP_ACTION
+};
+
+// 模拟线程发布给广播线程的不可变世界状态
+struct PublishedWorld
+{
+    uint64_t tick = 0;
+    std::vector<std::pair<int, EntityState>> entities;
+};
+
+class StateSyncServer : public Room
 {
 public:
+    typedef std::function<void(int player_id, const std::vector<uint8_t> &packet)> SendCallback;
+
+    StateSyncServer() : grid(WORLD_MIN, WORLD_MIN, WORLD_SIZE, WORLD_SIZE, INTEREST_RADIUS)
+    {
+        sender = [](int player_id, const std::vector<uint8_t> &packet)
+        {
+            std::cout << "Sending " << packet.size() << " bytes snapshot to player " << player_id << std::endl;
+        };
+    }
+
+    // 设置发送快照的方式，需在 start() 之前调用
+    void setSender(SendCallback cb)
+    {
+        sender = std::move(cb);
+    }
+
+    // 客户端确认收到快照，之后的快照以它为基线做增量编码
+    void ackSnapshot(int player_id, uint32_t seq)
+    {
+        std::lock_guard<std::mutex> lock(ack_mutex);
+        pending_acks.emplace_back(player_id, seq);
+    }
+
     void start()
     {
         running = true;
         server_thread = std::thread(&StateSyncServer::run, this);
+        broadcast_thread = std::thread(&StateSyncServer::runBroadcast, this);
     }
 
     void stop()
@@ -27,67 +100,223 @@ public:
         {
             server_thread.join();
         }
+        if (broadcast_thread.joinable())
+        {
+            broadcast_thread.join();
+        }
     }
 
-    void receiveInput(int player_id, const std::string &input)
+    // 作为房间挂到 RoomScheduler 上以 SIMULATION_FPS 运行时代替 start()/stop()
+    // 模拟和广播在同一次 tick 里完成，每 SIMULATION_FPS / BROADCAST_FPS 次模拟广播一次
+    void tick() override
     {
-        std::lock_guard<std::mutex> lock(state_mutex);
-        // 根据输入更新游戏状态
-        if (input == "MoveUp")
+        simulate();
+        if (tick_count % (SIMULATION_FPS / BROADCAST_FPS) == 0)
         {
-            game_states[player_id].player_position_y++;
+            broadcast();
         }
-        else if (input == "MoveDown")
+    }
+
+    // 玩家加入时登记，之后该玩家的输入由同一个网络线程投递
+    bool addPlayer(int player_id)
+    {
+        return input_queues.addPlayer(player_id);
+    }
+
+    // 网络线程调用：只把输入写入该玩家的 SPSC 队列，不会被模拟或广播阻塞
+    // 操作码未知或队列已满时返回 false；simulate() 依赖这里的校验按操作码查表
+    bool receiveInput(int player_id, const InputCmd &cmd)
+    {
+        if (cmd.op >= OP_COUNT)
         {
-            game_states[player_id].player_position_y--;
+            return false;
         }
-        // 其他输入处理
+        return input_queues.push(player_id, cmd);
+    }
+
+    // 解码一个二进制输入包（见 input_protocol.h），批量投递其中的所有输入
+    // 返回实际投递的条数（队列满时丢弃的不计），包格式错误时返回 -1
+    int receiveInputs(int player_id, const uint8_t *data, size_t len)
+    {
+        int pushed = 0;
+        int decoded = decodeInputPacket(data, len, [this, player_id, &pushed](const InputCmd &cmd)
+        {
+            pushed += receiveInput(player_id, cmd);
+        });
+        return decoded < 0 ? -1 : pushed;
     }
 
 private:
+    // 模拟线程：应用输入，写 back 缓冲并发布
     void run()
     {
+        FrameScheduler scheduler(SIMULATION_FPS, FrameScheduler::OverrunPolicy::Skip);
+        scheduler.start();
         while (running)
         {
-            auto start_time = std::chrono::steady_clock::now();
+            scheduler.waitNextFrame();
+            simulate();
+        }
+    }
 
-            // 广播当前的游戏状态
-            broadcastGameState();
+    void simulate()
+    {
+        input_queues.drainAll([this](int player_id, const InputCmd &cmd)
+        {
+            // 根据输入更新游戏状态，操作码已在 receiveInput 入队时校验过
+            g_apply_input[cmd.op](game_states[player_id], cmd);
+        });
+        publishGameState();
+    }
 
-            auto end_time = std::chrono::steady_clock::now();
-            std::this_thread::sleep_for(std::chrono::milliseconds(100) - (end_time - start_time));
+    void publishGameState()
+    {
+        PublishedWorld &back = world_buffer.back();
+        back.tick = ++tick_count;
+        back.entities.clear();
+        for (const auto &state : game_states)
+        {
+            back.entities.emplace_back(state.first, EntityState{state.second.player_position_x, state.second.player_position_y});
         }
+        world_buffer.publish();
     }
 
-    void broadcastGameState()
+    // 广播线程：只读取已发布的不可变状态，与输入处理和模拟互不等待
+    void runBroadcast()
+    {
+        FrameScheduler scheduler(BROADCAST_FPS, FrameScheduler::OverrunPolicy::Skip);
+        scheduler.start();
+        while (running)
+        {
+            scheduler.waitNextFrame();
+            broadcast();
+        }
+    }
+
+    void broadcast()
+    {
+        world_buffer.update();
+        broadcastGameState(world_buffer.front().entities);
+    }
+
+    void broadcastGameState(const std::vector<std::pair<int, EntityState>> &world)
     {
-        std::lock_guard<std::mutex> lock(state_mutex);
-        for (const auto &state : game_states)
         {
-            // 在此广播游戏状态给客户端
-            std::cout << "Broadcasting state of player " << state.first << " (x: "
-                      << state.second.player_position_x << ", y: "
-                      << state.second.player_position_y << ")" << std::endl;
+            std::lock_guard<std::mutex> lock(ack_mutex);
+            for (const auto &ack : pending_acks)
+            {
+                views[ack.first].ack(ack.second);
+            }
+            pending_acks.clear();
+        }
+
+        // 增量更新 AOI 网格：只有跨格的玩家才会移动格子列表
+        for (const auto &ent : world)
+        {
+            grid.move(ent.first, ent.second.x, ent.second.y);
+        }
+
+        for (const auto &self : world)
+        {
+            // 每个客户端只收到自己兴趣区域内的玩家，并以其最后确认的快照为基线做增量编码
+            std::vector<std::pair<int, EntityState>> visible;
+            grid.query(self.second.x, self.second.y, INTEREST_RADIUS, [&visible](int id, int x, int y)
+            {
+                visible.emplace_back(id, EntityState{x, y});
+            });
+
+            // 进出视野事件，可用于触发实体的创建和销毁
+            std::vector<int> &interest = interests[self.first];
+            visible_ids.clear();
+            for (const auto &ent : visible)
+            {
+                visible_ids.push_back(ent.first);
+            }
+            std::sort(visible_ids.begin(), visible_ids.end());
+            AoiGrid::diffInterest(interest, visible_ids, entered, left);
+            for (int id : entered)
+            {
+                std::cout << "Player " << id << " enters view of player " << self.first << std::endl;
+            }
+            for (int id : left)
+            {
+                std::cout << "Player " << id << " leaves view of player " << self.first << std::endl;
+            }
+            interest.swap(visible_ids);
+
+            packet.clear();
+            views[self.first].buildAndEncode(std::move(visible), packet);
+            sender(self.first, packet);
         }
     }
 
-    bool running = false;
+    std::atomic<bool> running{false};
     std::thread server_thread;
+    std::thread broadcast_thread;
+    PlayerInputQueues<MAX_PLAYERS, 256> input_queues;
+
+    // 以下只由模拟线程访问
     std::unordered_map<int, GameState> game_states;
-    std::mutex state_mutex;
+    uint64_t tick_count = 0;
+
+    // 模拟线程写、广播线程读
+    TripleBuffer<PublishedWorld> world_buffer;
+
+    // 以下只由广播线程访问
+    std::unordered_map<int, ClientView> views;
+    AoiGrid grid;
+    std::unordered_map<int, std::vector<int>> interests;
+    std::vector<int> visible_ids, entered, left;
+    std::vector<uint8_t> packet;
+    SendCallback sender;
+
+    std::vector<std::pair<int, uint32_t>> pending_acks;
+    std::mutex ack_mutex;
 };
 
 int main()
 {
     StateSyncServer server;
+
+    // 模拟客户端：解码快照后立即确认
+    std::unordered_map<int, SnapshotHistory> client_history;
+    size_t total_bytes = 0;
+    int packets = 0;
+    server.setSender([&](int player_id, const std::vector<uint8_t> &packet)
+    {
+        Snapshot snap;
+        if (decodeSnapshot(packet.data(), packet.size(), client_history[player_id], snap))
+        {
+            client_history[player_id].put(snap);
+            server.ackSnapshot(player_id, snap.seq);
+        }
+        total_bytes += packet.size();
+        ++packets;
+        std::cout << "Player " << player_id << " snapshot " << snap.seq << ": " << packet.size()
+                  << " bytes, sees " << snap.entities.size() << " players" << std::endl;
+    });
+    server.addPlayer(1);
+    server.addPlayer(2);
+    server.addPlayer(3);
     server.start();
 
     // 模拟玩家输入
-    server.receiveInput(1, "MoveUp");
-    server.receiveInput(2, "MoveDown");
+    InputPacketWriter writer;
+    writer.add(OP_MOVE_UP);
+    server.receiveInputs(1, writer.data(), writer.size());
+    writer.reset(0);
+    writer.add(OP_MOVE_DOWN);
+    server.receiveInputs(2, writer.data(), writer.size());
+    // 一个包携带多条输入
+    writer.reset(0);
+    writer.add(OP_MOVE_DIR, 0, 90);
+    writer.add(OP_MOVE_UP);
+    writer.add(OP_MOVE_RIGHT);
+    server.receiveInputs(3, writer.data(), writer.size());
 
     std::this_thread::sleep_for(std::chrono::seconds(1));
     server.stop();
+    std::cout << "total " << total_bytes << " bytes in " << packets << " snapshots" << std::endl;
 
     return 0;
 }
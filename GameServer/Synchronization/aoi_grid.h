@@ -0,0 +1,208 @@
+#ifndef __AOI_GRID_H__
+#define __AOI_GRID_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 均匀网格的兴趣区域（AOI）索引
+ *
+ * 世界被划分为 cell_size 大小的格子，每个格子保存其中实体的稠密下标列表。
+ * 实体的位置以 SoA（x、y 各一个连续数组）存放，范围查询只遍历覆盖查询区域的格子，并顺序读取坐标数组。
+ * move() 是增量的：只有实体跨格时才从旧格子的列表中删除（与末尾交换）并加入新格子。
+ * 超出世界范围的坐标被归入边界格子，查询时用真实坐标判断，所以结果依然正确。
+*/
+
+class AoiGrid {
+public:
+    AoiGrid(int min_x, int min_y, int width, int height, int cell_size)
+        : m_min_x(min_x), m_min_y(min_y), m_cell_size(cell_size),
+          m_cols(std::max(1, (width + cell_size - 1) / cell_size)),
+          m_rows(std::max(1, (height + cell_size - 1) / cell_size)),
+          m_cells(static_cast<size_t>(m_cols) * m_rows) {}
+
+    size_t size() const { return m_ids.size(); }
+
+    bool contains(int id) const { return m_index.count(id) != 0; }
+
+    void add(int id, int x, int y) {
+        if (contains(id)) {
+            move(id, x, y);
+            return;
+        }
+        uint32_t idx = static_cast<uint32_t>(m_ids.size());
+        uint32_t cell = cellOf(x, y);
+        m_index[id] = idx;
+        m_ids.push_back(id);
+        m_xs.push_back(x);
+        m_ys.push_back(y);
+        m_cell.push_back(cell);
+        m_slot.push_back(static_cast<uint32_t>(m_cells[cell].size()));
+        m_cells[cell].push_back(idx);
+    }
+
+    void remove(int id) {
+        auto it = m_index.find(id);
+        if (it == m_index.end()) {
+            return;
+        }
+        uint32_t idx = it->second;
+        m_index.erase(it);
+        unlinkFromCell(idx);
+
+        /// 稠密数组中用最后一个实体填补空位，并修正它在格子列表中的下标
+        uint32_t last = static_cast<uint32_t>(m_ids.size() - 1);
+        if (idx != last) {
+            m_ids[idx] = m_ids[last];
+            m_xs[idx] = m_xs[last];
+            m_ys[idx] = m_ys[last];
+            m_cell[idx] = m_cell[last];
+            m_slot[idx] = m_slot[last];
+            m_cells[m_cell[idx]][m_slot[idx]] = idx;
+            m_index[m_ids[idx]] = idx;
+        }
+        m_ids.pop_back();
+        m_xs.pop_back();
+        m_ys.pop_back();
+        m_cell.pop_back();
+        m_slot.pop_back();
+    }
+
+    void move(int id, int x, int y) {
+        auto it = m_index.find(id);
+        if (it == m_index.end()) {
+            add(id, x, y);
+            return;
+        }
+        uint32_t idx = it->second;
+        m_xs[idx] = x;
+        m_ys[idx] = y;
+        uint32_t cell = cellOf(x, y);
+        if (cell != m_cell[idx]) {
+            unlinkFromCell(idx);
+            m_cell[idx] = cell;
+            m_slot[idx] = static_cast<uint32_t>(m_cells[cell].size());
+            m_cells[cell].push_back(idx);
+        }
+    }
+
+    /// 对所有满足 |ex - x| <= radius 且 |ey - y| <= radius 的实体调用 f(id, ex, ey)
+    template <class F>
+    void query(int x, int y, int radius, F&& f) const {
+        int c0 = colOf(x - radius), c1 = colOf(x + radius);
+        int r0 = rowOf(y - radius), r1 = rowOf(y + radius);
+        for (int r = r0; r <= r1; ++r) {
+            for (int c = c0; c <= c1; ++c) {
+                for (uint32_t idx : m_cells[static_cast<size_t>(r) * m_cols + c]) {
+                    int ex = m_xs[idx], ey = m_ys[idx];
+                    if (abs(ex - x) <= radius && abs(ey - y) <= radius) {
+                        f(m_ids[idx], ex, ey);
+                    }
+                }
+            }
+        }
+    }
+
+    /// 按 id 升序返回查询结果
+    void queryIds(int x, int y, int radius, std::vector<int>& out) const {
+        out.clear();
+        query(x, y, radius, [&out](int id, int, int) { out.push_back(id); });
+        std::sort(out.begin(), out.end());
+    }
+
+    /**
+     * 碰撞检测：对所有距离（切比雪夫距离）不超过 dist 的实体对调用 f(id_a, id_b)，每对只调用一次
+     * dist 不应大于 cell_size，这样只需检查本格子和右、下方向的相邻格子
+    */
+    template <class F>
+    void forEachPairWithin(int dist, F&& f) const {
+        static const int NEIGHBORS[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+        for (int r = 0; r < m_rows; ++r) {
+            for (int c = 0; c < m_cols; ++c) {
+                const std::vector<uint32_t>& cell = m_cells[static_cast<size_t>(r) * m_cols + c];
+                for (size_t i = 0; i < cell.size(); ++i) {
+                    for (size_t j = i + 1; j < cell.size(); ++j) {
+                        testPair(cell[i], cell[j], dist, f);
+                    }
+                }
+                for (const auto& d : NEIGHBORS) {
+                    int nc = c + d[0], nr = r + d[1];
+                    if (nc < 0 || nc >= m_cols || nr >= m_rows) {
+                        continue;
+                    }
+                    for (uint32_t a : cell) {
+                        for (uint32_t b : m_cells[static_cast<size_t>(nr) * m_cols + nc]) {
+                            testPair(a, b, dist, f);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * 兴趣集合的进出事件：prev 和 now 都是升序 id 列表
+     * 在 now 而不在 prev 中的 id 进入 entered，反之进入 left
+    */
+    static void diffInterest(const std::vector<int>& prev, const std::vector<int>& now,
+                             std::vector<int>& entered, std::vector<int>& left) {
+        entered.clear();
+        left.clear();
+        std::set_difference(now.begin(), now.end(), prev.begin(), prev.end(), std::back_inserter(entered));
+        std::set_difference(prev.begin(), prev.end(), now.begin(), now.end(), std::back_inserter(left));
+    }
+
+private:
+    int colOf(int x) const {
+        int c = x < m_min_x ? 0 : (x - m_min_x) / m_cell_size;
+        return c >= m_cols ? m_cols - 1 : c;
+    }
+
+    int rowOf(int y) const {
+        int r = y < m_min_y ? 0 : (y - m_min_y) / m_cell_size;
+        return r >= m_rows ? m_rows - 1 : r;
+    }
+
+    uint32_t cellOf(int x, int y) const {
+        return static_cast<uint32_t>(rowOf(y) * m_cols + colOf(x));
+    }
+
+    void unlinkFromCell(uint32_t idx) {
+        std::vector<uint32_t>& cell = m_cells[m_cell[idx]];
+        uint32_t slot = m_slot[idx];
+        uint32_t moved = cell.back();
+        cell[slot] = moved;
+        m_slot[moved] = slot;
+        cell.pop_back();
+    }
+
+    template <class F>
+    void testPair(uint32_t a, uint32_t b, int dist, F& f) const {
+        if (abs(m_xs[a] - m_xs[b]) <= dist && abs(m_ys[a] - m_ys[b]) <= dist) {
+            f(m_ids[a], m_ids[b]);
+        }
+    }
+
+    int m_min_x;
+    int m_min_y;
+    int m_cell_size;
+    int m_cols;
+    int m_rows;
+
+    /// SoA 实体数据，下标为稠密下标
+    std::vector<int> m_ids;
+    std::vector<int32_t> m_xs;
+    std::vector<int32_t> m_ys;
+    std::vector<uint32_t> m_cell;   /// 所在格子
+    std::vector<uint32_t> m_slot;   /// 在格子列表中的位置
+
+    std::vector<std::vector<uint32_t>> m_cells;
+    std::unordered_map<int, uint32_t> m_index;  /// 实体 id -> 稠密下标
+};
+
+#endif
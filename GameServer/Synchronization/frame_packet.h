@@ -0,0 +1,304 @@
+#ifndef __FRAME_PACKET_H__
+#define __FRAME_PACKET_H__
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "input_queue.h"
+
+/**
+ * 帧同步的二进制广播包
+ *
+ * 每帧把该帧收集到的所有玩家输入打包成一个块，广播包里带上最近 K 帧的块（冗余），
+ * 客户端丢掉一个包时可以从后续包里补齐，不需要重传往返。
+ * 整个包每帧只编码一次，然后对每个客户端各发送一次（UDP sendto 或 TCP 带长度前缀的 send）。
+ *
+ * 包格式（小端）：
+ *   PacketHeader { magic u16, version u8, nblocks u8, latest_frame u32 }
+ *   nblocks 个块，从旧到新：{ frame_delta u8（latest_frame - frame）, count u16, count 个 InputEntry }
+ *   InputEntry { player u16, op u8, flags u8, arg0 i16, arg1 i16 }，8 字节
+ * 版本 2 把 count 从 u8 扩成 u16：64 个玩家各 64 条的输入队列一帧最多 4096 条，u8 会截断输入导致客户端不同步。
+*/
+
+#define FRAME_PACKET_MAGIC 0x4653   /// "FS"
+#define FRAME_PACKET_VERSION 2
+#define FRAME_PACKET_MAX_SIZE 1200  /// 冗余块只在这个大小以内附带，控制在常见 MTU 以内，避免 IP 分片
+#define FRAME_PACKET_MAX_DATAGRAM 65507 /// 单帧输入很多时最新一帧独占一个包，可能超过 MTU，但不能超过 UDP 上限
+#define FRAME_TCP_MAX_BACKLOG (256 * 1024) /// TCP 客户端未发出的数据超过这个量时断开该客户端
+
+/// 一帧内的一条输入
+struct FrameInput {
+    uint16_t player;
+    InputCmd cmd;
+};
+
+inline void put_u16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(static_cast<uint8_t>(v));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+inline void put_u32(std::vector<uint8_t>& out, uint32_t v) {
+    put_u16(out, static_cast<uint16_t>(v));
+    put_u16(out, static_cast<uint16_t>(v >> 16));
+}
+
+inline uint16_t get_u16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t get_u32(const uint8_t* p) {
+    return get_u16(p) | (static_cast<uint32_t>(get_u16(p + 2)) << 16);
+}
+
+/**
+ * 服务器端编码器：保存最近 K 帧已编码的块，每帧拼出一个广播包
+ * 包超过 FRAME_PACKET_MAX_SIZE 时较旧的冗余块会被省略，最新一帧总是完整保留；
+ * 最新一帧本身放不进一个 UDP 包（超过 FRAME_PACKET_MAX_DATAGRAM）时抛出 std::length_error，而不是悄悄丢掉输入
+*/
+template <int K>
+class FramePacketEncoder {
+    static_assert(K >= 1 && K <= 255, "redundancy must fit frame_delta");
+
+public:
+    FramePacketEncoder() : m_count(0) {}
+
+    /// 编码第 frame 帧的输入，返回的包在下一次 encode 之前有效
+    const std::vector<uint8_t>& encode(uint32_t frame, const std::vector<FrameInput>& inputs) {
+        /// 先把本帧编码成块（不含 frame_delta），放入历史环
+        Block& block = m_history[m_count % K];
+        block.frame = frame;
+        block.bytes.clear();
+        if (8 + 3 + inputs.size() * 8 > FRAME_PACKET_MAX_DATAGRAM) {
+            throw std::length_error("frame " + std::to_string(frame) + " has too many inputs for one packet");
+        }
+        put_u16(block.bytes, static_cast<uint16_t>(inputs.size()));
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            const FrameInput& in = inputs[i];
+            put_u16(block.bytes, in.player);
+            block.bytes.push_back(static_cast<uint8_t>(in.cmd.op));
+            block.bytes.push_back(static_cast<uint8_t>(in.cmd.flags));
+            put_u16(block.bytes, static_cast<uint16_t>(in.cmd.arg0));
+            put_u16(block.bytes, static_cast<uint16_t>(in.cmd.arg1));
+        }
+        ++m_count;
+
+        /// 从最新的块往回数，尽量多带冗余块
+        int nblocks = 0;
+        size_t size = 8;
+        int avail = m_count < static_cast<uint64_t>(K) ? static_cast<int>(m_count) : K;
+        for (int i = 0; i < avail; ++i) {
+            const Block& b = m_history[(m_count - 1 - i) % K];
+            if (frame - b.frame > 255 || (i > 0 && size + 1 + b.bytes.size() > FRAME_PACKET_MAX_SIZE)) {
+                break;
+            }
+            size += 1 + b.bytes.size();
+            ++nblocks;
+        }
+
+        m_packet.clear();
+        put_u16(m_packet, FRAME_PACKET_MAGIC);
+        m_packet.push_back(FRAME_PACKET_VERSION);
+        m_packet.push_back(static_cast<uint8_t>(nblocks));
+        put_u32(m_packet, frame);
+        for (int i = nblocks - 1; i >= 0; --i) {
+            const Block& b = m_history[(m_count - 1 - i) % K];
+            m_packet.push_back(static_cast<uint8_t>(frame - b.frame));
+            m_packet.insert(m_packet.end(), b.bytes.begin(), b.bytes.end());
+        }
+        return m_packet;
+    }
+
+private:
+    struct Block {
+        uint32_t frame;
+        std::vector<uint8_t> bytes;
+    };
+
+    Block m_history[K];
+    uint64_t m_count;
+    std::vector<uint8_t> m_packet;
+};
+
+/**
+ * 客户端解码：按帧号顺序应用输入，重复的冗余帧被跳过
+ * on_frame(frame, inputs) 对每个新的帧调用一次；返回 false 表示包格式错误
+ * 如果包里最旧的帧仍比期望的帧新，说明连续丢包超过了冗余度，lost 记录缺失的帧数
+*/
+class FramePacketDecoder {
+public:
+    FramePacketDecoder() : m_started(false), m_next_frame(0), m_lost(0) {}
+
+    template <class F>
+    bool decode(const uint8_t* data, size_t len, F&& on_frame) {
+        if (len < 8 || get_u16(data) != FRAME_PACKET_MAGIC || data[2] != FRAME_PACKET_VERSION) {
+            return false;
+        }
+        int nblocks = data[3];
+        uint32_t latest = get_u32(data + 4);
+        const uint8_t* p = data + 8;
+        const uint8_t* end = data + len;
+
+        for (int i = 0; i < nblocks; ++i) {
+            if (end - p < 3) {
+                return false;
+            }
+            uint32_t frame = latest - p[0];
+            size_t count = get_u16(p + 1);
+            p += 3;
+            if (static_cast<size_t>(end - p) < count * 8) {
+                return false;
+            }
+            /// 中途加入的客户端从收到的第一个包里最旧的帧开始
+            if (!m_started) {
+                m_started = true;
+                m_next_frame = frame;
+            }
+            if (frame >= m_next_frame) {
+                if (frame > m_next_frame) {
+                    m_lost += frame - m_next_frame;
+                }
+                m_inputs.clear();
+                for (size_t j = 0; j < count; ++j, p += 8) {
+                    FrameInput in;
+                    in.player = get_u16(p);
+                    in.cmd.frame = frame;
+                    in.cmd.op = p[2];
+                    in.cmd.flags = p[3];
+                    in.cmd.arg0 = static_cast<int16_t>(get_u16(p + 4));
+                    in.cmd.arg1 = static_cast<int16_t>(get_u16(p + 6));
+                    m_inputs.push_back(in);
+                }
+                on_frame(frame, m_inputs);
+                m_next_frame = frame + 1;
+            } else {
+                p += count * 8;
+            }
+        }
+        return true;
+    }
+
+    uint32_t nextFrame() const { return m_next_frame; }
+    uint64_t lost() const { return m_lost; }
+
+private:
+    bool m_started;
+    uint32_t m_next_frame;
+    uint64_t m_lost;
+    std::vector<FrameInput> m_inputs;
+};
+
+/**
+ * 把同一个已编码的包发给所有客户端：UDP 客户端用 sendto，TCP 客户端加 2 字节长度前缀
+ * TCP 用非阻塞 send，没发完的部分留在该客户端的发送缓冲里，下一次广播时先补发，保证流里的记录不会被截断；
+ * 积压超过 FRAME_TCP_MAX_BACKLOG 的客户端被 shutdown 并移出列表（fd 仍由调用者关闭）
+*/
+class FrameBroadcaster {
+public:
+    explicit FrameBroadcaster(int udpfd = -1) : m_udpfd(udpfd) {}
+
+    void addUdpClient(const sockaddr_in& addr) { m_udp_clients.push_back(addr); }
+    void addTcpClient(int fd) { m_tcp_clients.push_back(TcpClient{fd, std::vector<uint8_t>(), 0}); }
+
+    /// 返回发送失败的 UDP 客户端和本次被断开的 TCP 客户端个数
+    int broadcast(const std::vector<uint8_t>& packet) {
+        int failed = 0;
+        for (const sockaddr_in& addr : m_udp_clients) {
+            if (sendto(m_udpfd, packet.data(), packet.size(), MSG_DONTWAIT,
+                       reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+                ++failed;
+            }
+        }
+        if (!m_tcp_clients.empty()) {
+            m_framed.clear();
+            put_u16(m_framed, static_cast<uint16_t>(packet.size()));
+            m_framed.insert(m_framed.end(), packet.begin(), packet.end());
+            for (size_t i = 0; i < m_tcp_clients.size();) {
+                if (sendTcp(m_tcp_clients[i])) {
+                    ++i;
+                } else {
+                    shutdown(m_tcp_clients[i].fd, SHUT_RDWR);
+                    m_tcp_clients[i] = std::move(m_tcp_clients.back());
+                    m_tcp_clients.pop_back();
+                    ++failed;
+                }
+            }
+        }
+        return failed;
+    }
+
+    /// 仍有数据积压的 TCP 客户端个数
+    size_t backloggedTcpClients() const {
+        size_t n = 0;
+        for (const TcpClient& c : m_tcp_clients) {
+            n += c.pending.size() > c.sent;
+        }
+        return n;
+    }
+
+private:
+    struct TcpClient {
+        int fd;
+        std::vector<uint8_t> pending;   /// 尚未完整发出的记录，从 sent 处继续
+        size_t sent;
+    };
+
+    /// 先补发积压数据，再发本帧；返回 false 表示连接出错或积压过多，应断开
+    bool sendTcp(TcpClient& c) {
+        if (c.pending.size() > c.sent && !flushTcp(c)) {
+            return false;
+        }
+        if (c.pending.size() > c.sent) {
+            /// 上次的数据还没发完，本帧整条排在后面
+            if (c.pending.size() - c.sent + m_framed.size() > FRAME_TCP_MAX_BACKLOG) {
+                return false;
+            }
+            if (c.sent > 0) {
+                c.pending.erase(c.pending.begin(), c.pending.begin() + c.sent);
+                c.sent = 0;
+            }
+            c.pending.insert(c.pending.end(), m_framed.begin(), m_framed.end());
+            return true;
+        }
+        c.pending.clear();
+        c.sent = 0;
+        ssize_t n = send(c.fd, m_framed.data(), m_framed.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                return false;
+            }
+            n = 0;
+        }
+        if (static_cast<size_t>(n) < m_framed.size()) {
+            c.pending.assign(m_framed.begin() + n, m_framed.end());
+        }
+        return true;
+    }
+
+    bool flushTcp(TcpClient& c) {
+        while (c.sent < c.pending.size()) {
+            ssize_t n = send(c.fd, c.pending.data() + c.sent, c.pending.size() - c.sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            c.sent += n;
+        }
+        return true;
+    }
+
+    int m_udpfd;
+    std::vector<sockaddr_in> m_udp_clients;
+    std::vector<TcpClient> m_tcp_clients;
+    std::vector<uint8_t> m_framed;
+};
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef __FRAME_SCHEDULER_H__
+#define __FRAME_SCHEDULER_H__
+
+#include <time.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <ostream>
+
+/**
+ * 固定步长的帧调度器
+ *
+ * 第 n 帧的截止时间是 start + n * 1s / fps（用整数纳秒计算，没有 1000 / fps 的取整误差，也不会累积漂移），
+ * 使用 clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME) 睡到绝对时间点，上一帧的耗时和唤醒延迟不会累加到下一帧。
+ * 某帧超时（错过一个或多个截止时间）时按策略处理：
+ *   - CatchUp: 连续补跑错过的帧（最多 max_catch_up 帧，超出部分丢弃），模拟时间与真实时间保持一致；
+ *   - Skip:    丢弃错过的帧，直接对齐到下一个截止时间。
+ * 同时统计每帧的唤醒抖动和超时帧数直方图。
+*/
+
+/// 以 2 的幂为桶边界的直方图，第 i 个桶统计 [2^(i-1), 2^i) 的样本，第 0 个桶统计 0
+class Log2Histogram {
+public:
+    static const int BUCKETS = 24;
+
+    Log2Histogram() { reset(); }
+
+    void add(uint64_t value) {
+        int b = 0;
+        while (value != 0 && b < BUCKETS - 1) {
+            value >>= 1;
+            ++b;
+        }
+        ++m_buckets[b];
+        ++m_count;
+    }
+
+    uint64_t count() const { return m_count; }
+
+    void reset() {
+        for (int i = 0; i < BUCKETS; ++i) {
+            m_buckets[i] = 0;
+        }
+        m_count = 0;
+    }
+
+    /// 打印非空的桶，unit 是样本单位
+    void print(std::ostream& os, const char* unit) const {
+        for (int i = 0; i < BUCKETS; ++i) {
+            if (m_buckets[i] == 0) {
+                continue;
+            }
+            uint64_t lo = i == 0 ? 0 : (1ULL << (i - 1));
+            uint64_t hi = 1ULL << i;
+            os << "  [" << lo << ", " << hi << ") " << unit << ": " << m_buckets[i] << "\n";
+        }
+    }
+
+private:
+    uint64_t m_buckets[BUCKETS];
+    uint64_t m_count;
+};
+
+struct FrameStats {
+    uint64_t frames = 0;            /// 执行的帧数（含补跑）
+    uint64_t overruns = 0;          /// 错过截止时间的次数
+    uint64_t caught_up = 0;         /// 补跑的帧数
+    uint64_t skipped = 0;           /// 丢弃的帧数
+    uint64_t max_jitter_us = 0;
+    Log2Histogram jitter_us;        /// 实际唤醒时间 - 截止时间（微秒）
+    Log2Histogram overrun_frames;   /// 每次超时错过的帧数
+};
+
+class FrameScheduler {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    enum class OverrunPolicy {
+        CatchUp,
+        Skip,
+    };
+
+    FrameScheduler(int fps, OverrunPolicy policy = OverrunPolicy::CatchUp, int max_catch_up = 5)
+        : m_fps(fps), m_policy(policy), m_max_catch_up(max_catch_up), m_next(0) {}
+
+    /// 以当前时间为第 0 帧的起点
+    void start() {
+        m_start = clock::now();
+        m_next = 0;
+    }
+
+    /**
+     * 睡到下一帧的截止时间，返回本次需要执行的帧数（至少为 1）
+     * 返回值大于 1 说明上一帧超时，需要补跑
+    */
+    int waitNextFrame() {
+        clock::time_point deadline = deadlineOf(m_next);
+        clock::time_point now = clock::now();
+
+        if (now < deadline) {
+            sleepUntil(deadline);
+            now = clock::now();
+            recordJitter(now - deadline);
+            ++m_next;
+            ++m_stats.frames;
+            return 1;
+        }
+
+        /// 已经超过截止时间：计算错过了几帧（当前这一帧也算在内）
+        uint64_t due = framesDue(now);
+        uint64_t missed = due - m_next;
+        recordJitter(now - deadline);
+        if (missed <= 1) {
+            ++m_next;
+            ++m_stats.frames;
+            return 1;
+        }
+
+        ++m_stats.overruns;
+        m_stats.overrun_frames.add(missed - 1);
+        uint64_t run = 1;
+        if (m_policy == OverrunPolicy::CatchUp) {
+            run = missed < static_cast<uint64_t>(m_max_catch_up) ? missed : m_max_catch_up;
+            m_stats.caught_up += run - 1;
+        }
+        m_stats.skipped += missed - run;
+        m_next = due;
+        m_stats.frames += run;
+        return static_cast<int>(run);
+    }
+
+    /// 下一帧的帧序号，也就是已经调度过的帧数
+    uint64_t nextFrame() const { return m_next; }
+
+    const FrameStats& stats() const { return m_stats; }
+
+    void report(std::ostream& os) const {
+        os << "frames=" << m_stats.frames << " overruns=" << m_stats.overruns
+           << " caught_up=" << m_stats.caught_up << " skipped=" << m_stats.skipped
+           << " max_jitter=" << m_stats.max_jitter_us << "us\n";
+        os << "jitter histogram:\n";
+        m_stats.jitter_us.print(os, "us");
+        if (m_stats.overrun_frames.count() > 0) {
+            os << "overrun histogram (frames missed):\n";
+            m_stats.overrun_frames.print(os, "frames");
+        }
+    }
+
+private:
+    /// 第 n 帧的截止时间，第 n 帧在 deadlineOf(n) 之后开始执行
+    clock::time_point deadlineOf(uint64_t n) const {
+        return m_start + std::chrono::nanoseconds((n + 1) * 1000000000ULL / m_fps);
+    }
+
+    /// now 时刻之前截止时间已经到达的帧数
+    uint64_t framesDue(clock::time_point now) const {
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_start).count();
+        return elapsed * m_fps / 1000000000ULL;
+    }
+
+    void recordJitter(clock::duration late) {
+        uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(late).count();
+        m_stats.jitter_us.add(us);
+        if (us > m_stats.max_jitter_us) {
+            m_stats.max_jitter_us = us;
+        }
+    }
+
+    /// steady_clock 在 Linux 上就是 CLOCK_MONOTONIC，可以直接换算成 clock_nanosleep 的绝对时间
+    static void sleepUntil(clock::time_point deadline) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+        struct timespec ts;
+        ts.tv_sec = ns / 1000000000;
+        ts.tv_nsec = ns % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+    }
+
+    int m_fps;
+    OverrunPolicy m_policy;
+    int m_max_catch_up;
+    uint64_t m_next;
+    clock::time_point m_start;
+    FrameStats m_stats;
+};
+
+#endif
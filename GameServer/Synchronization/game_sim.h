@@ -0,0 +1,103 @@
+#ifndef __GAME_SIM_H__
+#define __GAME_SIM_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "input_protocol.h"
+
+/**
+ * 帧同步使用的确定性模拟
+ *
+ * 帧同步要求所有端用相同的输入序列得到完全相同的状态，所以这里只用整数（16.16 定点数）运算，
+ * 不使用浮点、随机数、系统时间和无序容器的遍历顺序。
+ * checksum() 对完整状态做 FNV-1a 哈希，录像回放时逐帧对比即可发现不确定性。
+*/
+
+#define SIM_MAX_PLAYERS 64
+#define SIM_ONE 65536               /// 定点数的 1.0
+#define SIM_SPEED (SIM_ONE / 4)     /// 方向键给出的速度：每帧 0.25
+#define SIM_WORLD (1024 * SIM_ONE)  /// 世界坐标范围 [-SIM_WORLD, SIM_WORLD]
+
+struct SimPlayer {
+    int32_t x;
+    int32_t y;
+    int32_t vx;
+    int32_t vy;
+    uint32_t active;
+    uint32_t actions;
+};
+
+class FrameSimulation {
+public:
+    FrameSimulation() { reset(); }
+
+    void reset() {
+        memset(m_players, 0, sizeof(m_players));
+        m_frame = 0;
+    }
+
+    /// 应用一条输入，必须在该帧的 step() 之前按固定顺序（玩家 id 升序、同一玩家按到达顺序）调用
+    void apply(uint16_t player, const InputCmd& cmd) {
+        if (player >= SIM_MAX_PLAYERS) {
+            return;
+        }
+        SimPlayer& p = m_players[player];
+        p.active = 1;
+        switch (cmd.op) {
+        case OP_MOVE_UP: p.vy = SIM_SPEED; break;
+        case OP_MOVE_DOWN: p.vy = -SIM_SPEED; break;
+        case OP_MOVE_LEFT: p.vx = -SIM_SPEED; break;
+        case OP_MOVE_RIGHT: p.vx = SIM_SPEED; break;
+        case OP_MOVE_DIR:
+            p.vx = cmd.arg0 * (SIM_SPEED / 8);
+            p.vy = cmd.arg1 * (SIM_SPEED / 8);
+            break;
+        case OP_ACTION: ++p.actions; break;
+        default: break;
+        }
+    }
+
+    /// 推进一帧：积分位置，速度按 7/8 衰减，坐标限制在世界范围内
+    void step() {
+        for (int i = 0; i < SIM_MAX_PLAYERS; ++i) {
+            SimPlayer& p = m_players[i];
+            if (!p.active) {
+                continue;
+            }
+            p.x = clamp(p.x + p.vx);
+            p.y = clamp(p.y + p.vy);
+            p.vx -= p.vx / 8;
+            p.vy -= p.vy / 8;
+        }
+        ++m_frame;
+    }
+
+    uint64_t checksum() const {
+        uint64_t h = 1469598103934665603ULL;
+        h = fnv1a(h, &m_frame, sizeof(m_frame));
+        return fnv1a(h, m_players, sizeof(m_players));
+    }
+
+    uint32_t frame() const { return m_frame; }
+    const SimPlayer& player(int i) const { return m_players[i]; }
+
+private:
+    static int32_t clamp(int32_t v) {
+        return v < -SIM_WORLD ? -SIM_WORLD : (v > SIM_WORLD ? SIM_WORLD : v);
+    }
+
+    static uint64_t fnv1a(uint64_t h, const void* data, size_t len) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < len; ++i) {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    SimPlayer m_players[SIM_MAX_PLAYERS];
+    uint32_t m_frame;
+};
+
+#endif
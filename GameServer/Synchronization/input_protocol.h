@@ -0,0 +1,137 @@
+#ifndef __INPUT_PROTOCOL_H__
+#define __INPUT_PROTOCOL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "input_queue.h"
+
+/**
+ * 客户端上行输入的二进制协议，FrameSyncServer 和 StateSyncServer 共用
+ *
+ * 一个包里可以携带多条输入，服务器一次解码、批量投递：
+ *   u8 version | u8 count | u32 frame（小端） | count 条 { u8 op | 定长 payload }
+ * 每个操作码的 payload 长度和解码函数由 g_input_ops 表决定，解码时不做任何字符串比较。
+ * 增加新操作码只需在 InputOp 末尾追加并在表中登记；修改已有操作码的格式时必须递增 INPUT_PROTOCOL_VERSION。
+*/
+
+#define INPUT_PROTOCOL_VERSION 1
+#define INPUT_HEADER_SIZE 6
+#define INPUT_MAX_BATCH 255
+
+enum InputOp : uint16_t {
+    OP_NONE = 0,
+    OP_MOVE_UP,
+    OP_MOVE_DOWN,
+    OP_MOVE_LEFT,
+    OP_MOVE_RIGHT,
+    OP_MOVE_DIR,    /// payload: i16 dx, i16 dy
+    OP_ACTION,      /// payload: u16 action, u16 target
+    OP_COUNT,
+};
+
+inline uint16_t load_u16le(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+/// 操作码表项：payload 长度和把 payload 填入 InputCmd 的函数
+struct InputOpInfo {
+    uint8_t payload_size;
+    void (*decode)(const uint8_t* payload, InputCmd& cmd);
+};
+
+inline void decode_no_payload(const uint8_t*, InputCmd&) {}
+
+inline void decode_two_i16(const uint8_t* payload, InputCmd& cmd) {
+    cmd.arg0 = static_cast<int16_t>(load_u16le(payload));
+    cmd.arg1 = static_cast<int16_t>(load_u16le(payload + 2));
+}
+
+static const InputOpInfo g_input_ops[OP_COUNT] = {
+    {0, decode_no_payload},     /// OP_NONE
+    {0, decode_no_payload},     /// OP_MOVE_UP
+    {0, decode_no_payload},     /// OP_MOVE_DOWN
+    {0, decode_no_payload},     /// OP_MOVE_LEFT
+    {0, decode_no_payload},     /// OP_MOVE_RIGHT
+    {4, decode_two_i16},        /// OP_MOVE_DIR
+    {4, decode_two_i16},        /// OP_ACTION
+};
+
+/**
+ * 解码一个输入包，对每条输入调用 f(cmd)
+ * 返回解码出的条数；版本不符、操作码未知或长度不对时返回 -1，此时不会调用 f，整包丢弃
+*/
+template <class F>
+int decodeInputPacket(const uint8_t* data, size_t len, F&& f) {
+    if (len < INPUT_HEADER_SIZE || data[0] != INPUT_PROTOCOL_VERSION) {
+        return -1;
+    }
+    int count = data[1];
+    uint32_t frame = load_u16le(data + 2) | (static_cast<uint32_t>(load_u16le(data + 4)) << 16);
+
+    /// 先校验整个包，保证一个包要么全部生效、要么全部丢弃
+    size_t pos = INPUT_HEADER_SIZE;
+    for (int i = 0; i < count; ++i) {
+        if (pos >= len || data[pos] >= OP_COUNT) {
+            return -1;
+        }
+        pos += 1 + g_input_ops[data[pos]].payload_size;
+    }
+    if (pos != len) {
+        return -1;
+    }
+
+    pos = INPUT_HEADER_SIZE;
+    for (int i = 0; i < count; ++i) {
+        const InputOpInfo& info = g_input_ops[data[pos]];
+        InputCmd cmd = {frame, data[pos], 0, 0, 0};
+        info.decode(data + pos + 1, cmd);
+        f(cmd);
+        pos += 1 + info.payload_size;
+    }
+    return count;
+}
+
+/// 客户端（或测试代码）组装输入包
+class InputPacketWriter {
+public:
+    explicit InputPacketWriter(uint32_t frame = 0) { reset(frame); }
+
+    void reset(uint32_t frame) {
+        m_buf.assign(INPUT_HEADER_SIZE, 0);
+        m_buf[0] = INPUT_PROTOCOL_VERSION;
+        m_buf[2] = static_cast<uint8_t>(frame);
+        m_buf[3] = static_cast<uint8_t>(frame >> 8);
+        m_buf[4] = static_cast<uint8_t>(frame >> 16);
+        m_buf[5] = static_cast<uint8_t>(frame >> 24);
+    }
+
+    /// 追加一条输入，包已满或 payload 长度与操作码不符时返回 false
+    bool add(InputOp op, int16_t arg0 = 0, int16_t arg1 = 0) {
+        if (op >= OP_COUNT || m_buf[1] == INPUT_MAX_BATCH) {
+            return false;
+        }
+        m_buf.push_back(static_cast<uint8_t>(op));
+        if (g_input_ops[op].payload_size == 4) {
+            put(static_cast<uint16_t>(arg0));
+            put(static_cast<uint16_t>(arg1));
+        }
+        ++m_buf[1];
+        return true;
+    }
+
+    const uint8_t* data() const { return m_buf.data(); }
+    size_t size() const { return m_buf.size(); }
+
+private:
+    void put(uint16_t v) {
+        m_buf.push_back(static_cast<uint8_t>(v));
+        m_buf.push_back(static_cast<uint8_t>(v >> 8));
+    }
+
+    std::vector<uint8_t> m_buf;
+};
+
+#endif
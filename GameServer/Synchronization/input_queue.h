@@ -0,0 +1,153 @@
+#ifndef __INPUT_QUEUE_H__
+#define __INPUT_QUEUE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <type_traits>
+
+/**
+ * 每个玩家一个的单生产者单消费者（SPSC）无锁环形队列
+ *
+ * 生产者是负责该玩家连接的网络线程，消费者是帧线程。
+ * push/pop 都只有一次 load 和一次 store，没有 CAS 和锁，入队是 wait-free 的：队列满时直接返回 false。
+ * head 和 tail 分别放在独立的缓存行，并各自缓存对方的位置，减少跨核的缓存行来回传递。
+*/
+
+#define CACHE_LINE_SIZE 64
+
+/// 紧凑的二进制输入命令，12 字节，代替堆上分配的 std::string
+struct InputCmd {
+    uint32_t frame;     /// 客户端生成该输入时所在的帧
+    uint16_t op;        /// 操作码，见 input_protocol.h 中的 InputOp
+    uint16_t flags;
+    int16_t arg0;
+    int16_t arg1;
+};
+
+static_assert(sizeof(InputCmd) == 12, "InputCmd should stay compact");
+
+template <class T, size_t N>
+class SpscRing {
+    static_assert((N & (N - 1)) == 0, "capacity must be power of 2");
+    static_assert(std::is_trivially_copyable<T>::value, "ring elements are copied as raw values");
+
+public:
+    SpscRing() : m_head(0), m_cached_tail(0), m_tail(0), m_cached_head(0) {}
+
+    /// 生产者调用，队列满时返回 false
+    bool push(const T& value) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head == N) {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head == N) {
+                return false;
+            }
+        }
+        m_buf[tail & (N - 1)] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// 消费者调用，队列空时返回 false
+    bool pop(T& value) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cached_tail) {
+                return false;
+            }
+        }
+        value = m_buf[head & (N - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// 消费者调用：一次取出当前所有元素，对每个元素调用 f，返回取出的个数
+    template <class F>
+    size_t drain(F&& f) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        m_cached_tail = tail;
+        for (size_t i = head; i != tail; ++i) {
+            f(m_buf[i & (N - 1)]);
+        }
+        m_head.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+    static constexpr size_t capacity() { return N; }
+
+private:
+    /// 消费者独占的缓存行
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head;
+    size_t m_cached_tail;
+    /// 生产者独占的缓存行
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail;
+    size_t m_cached_head;
+    alignas(CACHE_LINE_SIZE) T m_buf[N];
+};
+
+/**
+ * 固定容量的玩家输入表：玩家 id 直接作为下标，查找不需要加锁
+ * 每个槽位的 active 标志由登记玩家的线程 release 写入，帧线程 acquire 读取
+*/
+template <size_t MAX_PLAYERS, size_t QUEUE_SIZE = 64>
+class PlayerInputQueues {
+public:
+    typedef SpscRing<InputCmd, QUEUE_SIZE> Queue;
+
+    PlayerInputQueues() : m_dropped(0) {
+        for (size_t i = 0; i < MAX_PLAYERS; ++i) {
+            m_slots[i].active.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /// 登记玩家，必须在该玩家的第一次 push 之前调用
+    bool addPlayer(int player_id) {
+        if (player_id < 0 || static_cast<size_t>(player_id) >= MAX_PLAYERS) {
+            return false;
+        }
+        m_slots[player_id].active.store(true, std::memory_order_release);
+        return true;
+    }
+
+    /// 网络线程调用（每个玩家只能有一个生产者线程），wait-free；队列满或玩家未登记时丢弃并返回 false
+    bool push(int player_id, const InputCmd& cmd) {
+        if (player_id < 0 || static_cast<size_t>(player_id) >= MAX_PLAYERS
+            || !m_slots[player_id].active.load(std::memory_order_acquire)
+            || !m_slots[player_id].queue.push(cmd)) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    /// 帧线程调用：依次取空所有玩家的队列，f(player_id, cmd)
+    template <class F>
+    size_t drainAll(F&& f) {
+        size_t n = 0;
+        for (size_t i = 0; i < MAX_PLAYERS; ++i) {
+            if (!m_slots[i].active.load(std::memory_order_acquire)) {
+                continue;
+            }
+            int player_id = static_cast<int>(i);
+            n += m_slots[i].queue.drain([&](const InputCmd& cmd) { f(player_id, cmd); });
+        }
+        return n;
+    }
+
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<bool> active;
+        Queue queue;
+    };
+
+    Slot m_slots[MAX_PLAYERS];
+    std::atomic<uint64_t> m_dropped;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "game_sim.h"
+#include "replay_log.h"
+
+/**
+ * 帧同步录像的无头回放：不按帧率等待，以最快速度重新模拟录像中的每一帧，
+ * 逐帧对比状态校验和，第一次不一致时报告分歧的帧号并退出，否则报告回放吞吐（帧/秒）。
+ * 回放吞吐可作为 FrameSimulation::step() 等模拟逻辑优化的基准。
+ * 编译: g++ -std=c++17 -O2 replay_bench.cpp -o replay_bench
+ * 运行: ./replay_bench <录像文件> [重复次数，默认 10]
+ *       ./replay_bench --record <录像文件> [帧数，默认 100000] [玩家数，默认 64]   生成随机输入的录像
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+static int record(const char* path, int frames, int players) {
+    ReplayWriter writer;
+    if (!writer.open(path, 60, SIM_MAX_PLAYERS)) {
+        std::cout << "cannot open " << path << std::endl;
+        return 1;
+    }
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> op(OP_NONE, OP_COUNT - 1);
+    std::uniform_int_distribution<int> arg(-8, 8);
+    FrameSimulation sim;
+    std::vector<FrameInput> inputs;
+    for (int f = 0; f < frames; ++f) {
+        inputs.clear();
+        /// 每帧约四分之一的玩家有输入，与服务器 drainAll 一样按玩家 id 升序
+        for (int p = 0; p < players; ++p) {
+            if (rng() % 4 == 0) {
+                InputCmd cmd = {static_cast<uint32_t>(f), static_cast<uint16_t>(op(rng)), 0,
+                                static_cast<int16_t>(arg(rng)), static_cast<int16_t>(arg(rng))};
+                inputs.push_back(FrameInput{static_cast<uint16_t>(p), cmd});
+                sim.apply(p, cmd);
+            }
+        }
+        sim.step();
+        writer.append(f, inputs, sim.checksum());
+    }
+    std::cout << "recorded " << frames << " frames, " << writer.size() << " bytes" << std::endl;
+    return 0;
+}
+
+/// 回放一遍，返回回放的帧数，出现分歧时返回 -1
+static long replay(ReplayReader& reader, FrameSimulation& sim) {
+    reader.rewind();
+    sim.reset();
+    ReplayFrameHeader fh;
+    const ReplayEntry* entries;
+    long frames = 0;
+    while (reader.next(fh, entries)) {
+        for (uint32_t i = 0; i < fh.count; ++i) {
+            const ReplayEntry& e = entries[i];
+            InputCmd cmd = {fh.frame, e.op, e.flags, e.arg0, e.arg1};
+            sim.apply(e.player, cmd);
+        }
+        sim.step();
+        if (sim.checksum() != fh.checksum) {
+            std::cout << "divergence at frame " << fh.frame << ": expected " << std::hex << fh.checksum
+                      << ", got " << sim.checksum() << std::dec << std::endl;
+            return -1;
+        }
+        ++frames;
+    }
+    return frames;
+}
+
+int main(int argc, char const *argv[]) {
+    if (argc > 2 && strcmp(argv[1], "--record") == 0) {
+        return record(argv[2], argc > 3 ? atoi(argv[3]) : 100000, argc > 4 ? atoi(argv[4]) : SIM_MAX_PLAYERS);
+    }
+    if (argc < 2) {
+        std::cout << "usage: " << argv[0] << " <replay file> [rounds] | --record <replay file> [frames] [players]" << std::endl;
+        return 1;
+    }
+
+    ReplayReader reader;
+    if (!reader.open(argv[1])) {
+        std::cout << "invalid replay file " << argv[1] << std::endl;
+        return 1;
+    }
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+    FrameSimulation sim;
+    long total = 0;
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        long frames = replay(reader, sim);
+        if (frames < 0) {
+            return 2;
+        }
+        total += frames;
+    }
+    double sec = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::cout << "replayed " << total / (rounds > 0 ? rounds : 1) << " frames x " << rounds
+              << " rounds (recorded at " << reader.header().fps << " fps), no divergence" << std::endl;
+    std::cout << "throughput: " << static_cast<long>(total / sec) << " frames/s, "
+              << sec * 1e9 / (total > 0 ? total : 1) << " ns/frame" << std::endl;
+    return 0;
+}
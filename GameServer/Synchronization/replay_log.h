@@ -0,0 +1,208 @@
+#ifndef __REPLAY_LOG_H__
+#define __REPLAY_LOG_H__
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "frame_packet.h"
+
+/**
+ * 帧同步录像：按帧追加写入的输入日志，读写都通过 mmap
+ *
+ * 文件格式（小端，本机字节序写入）：
+ *   ReplayFileHeader
+ *   若干 ReplayFrameHeader + count 个 ReplayEntry，按帧号递增
+ * 每帧记录该帧的全部输入和模拟后的状态校验和，回放时逐帧比较校验和即可发现不确定性。
+ * 每个帧头带 REPLAY_FRAME_MAGIC，帧号必须逐帧加一，读取端遇到不符合的帧头（例如文件末尾未截断的全零空间）就停止。
+ * 写入端按 REPLAY_GROW_SIZE 扩展文件并 mremap，追加一帧只是一次 memcpy，不产生系统调用；
+ * 进程崩溃时已写入的帧仍在页缓存中，close() 时把文件截断到实际长度。
+*/
+
+#define REPLAY_MAGIC 0x52504c59     /// "RPLY"
+#define REPLAY_VERSION 2
+#define REPLAY_FRAME_MAGIC 0x4652   /// "FR"
+#define REPLAY_GROW_SIZE (1 << 20)
+
+struct ReplayFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t fps;
+    uint32_t max_players;
+};
+
+struct ReplayFrameHeader {
+    uint16_t magic;         /// REPLAY_FRAME_MAGIC
+    uint16_t count;
+    uint32_t frame;
+    uint64_t checksum;      /// 应用本帧输入并 step() 之后的状态校验和
+};
+
+/// 与广播包中的输入条目相同的 8 字节布局
+struct ReplayEntry {
+    uint16_t player;
+    uint8_t op;
+    uint8_t flags;
+    int16_t arg0;
+    int16_t arg1;
+};
+
+static_assert(sizeof(ReplayFrameHeader) == 16 && sizeof(ReplayEntry) == 8, "replay layout is fixed");
+
+class ReplayWriter {
+public:
+    ReplayWriter() : m_fd(-1), m_base(nullptr), m_capacity(0), m_size(0) {}
+
+    ~ReplayWriter() { close(); }
+
+    bool open(const char* path, uint32_t fps, uint32_t max_players) {
+        m_fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (m_fd < 0 || !grow(REPLAY_GROW_SIZE)) {
+            close();
+            return false;
+        }
+        ReplayFileHeader hdr = {REPLAY_MAGIC, REPLAY_VERSION, fps, max_players};
+        memcpy(m_base, &hdr, sizeof(hdr));
+        m_size = sizeof(hdr);
+        return true;
+    }
+
+    bool isOpen() const { return m_base != nullptr; }
+
+    bool append(uint32_t frame, const std::vector<FrameInput>& inputs, uint64_t checksum) {
+        if (inputs.size() > UINT16_MAX) {
+            return false;
+        }
+        size_t need = sizeof(ReplayFrameHeader) + inputs.size() * sizeof(ReplayEntry);
+        if (m_size + need > m_capacity && !grow(m_capacity + need + REPLAY_GROW_SIZE)) {
+            return false;
+        }
+        ReplayFrameHeader fh = {REPLAY_FRAME_MAGIC, static_cast<uint16_t>(inputs.size()), frame, checksum};
+        memcpy(m_base + m_size, &fh, sizeof(fh));
+        ReplayEntry* entries = reinterpret_cast<ReplayEntry*>(m_base + m_size + sizeof(fh));
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            const InputCmd& cmd = inputs[i].cmd;
+            entries[i] = ReplayEntry{inputs[i].player, static_cast<uint8_t>(cmd.op),
+                                     static_cast<uint8_t>(cmd.flags), cmd.arg0, cmd.arg1};
+        }
+        m_size += need;
+        return true;
+    }
+
+    size_t size() const { return m_size; }
+
+    void close() {
+        if (m_base != nullptr) {
+            munmap(m_base, m_capacity);
+            m_base = nullptr;
+        }
+        if (m_fd >= 0) {
+            if (ftruncate(m_fd, m_size) == -1) {
+                /// 截断失败只会在文件末尾留下全零的空间，读取时按帧头校验会停在那里
+            }
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        m_capacity = 0;
+    }
+
+private:
+    bool grow(size_t capacity) {
+        capacity = (capacity + REPLAY_GROW_SIZE - 1) / REPLAY_GROW_SIZE * REPLAY_GROW_SIZE;
+        if (ftruncate(m_fd, capacity) == -1) {
+            return false;
+        }
+        void* p = m_base == nullptr
+                      ? mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0)
+                      : mremap(m_base, m_capacity, capacity, MREMAP_MAYMOVE);
+        if (p == MAP_FAILED) {
+            return false;
+        }
+        m_base = static_cast<char*>(p);
+        m_capacity = capacity;
+        return true;
+    }
+
+    int m_fd;
+    char* m_base;
+    size_t m_capacity;
+    size_t m_size;
+};
+
+class ReplayReader {
+public:
+    ReplayReader() : m_base(nullptr), m_size(0), m_pos(0), m_frames(0), m_last_frame(0) {}
+
+    ~ReplayReader() {
+        if (m_base != nullptr) {
+            munmap(const_cast<char*>(m_base), m_size);
+        }
+    }
+
+    bool open(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(ReplayFileHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            return false;
+        }
+        madvise(p, st.st_size, MADV_SEQUENTIAL);
+        m_base = static_cast<const char*>(p);
+        m_size = st.st_size;
+        memcpy(&m_header, m_base, sizeof(m_header));
+        m_pos = sizeof(m_header);
+        return m_header.magic == REPLAY_MAGIC && m_header.version == REPLAY_VERSION;
+    }
+
+    const ReplayFileHeader& header() const { return m_header; }
+
+    /// 读取下一帧，entries 直接指向映射的文件内容；没有更多帧或数据损坏时返回 false
+    /// 帧头 magic 不对或帧号不是上一帧加一时视为录像结束，之后的内容不再读取
+    bool next(ReplayFrameHeader& fh, const ReplayEntry*& entries) {
+        if (m_pos + sizeof(fh) > m_size) {
+            return false;
+        }
+        memcpy(&fh, m_base + m_pos, sizeof(fh));
+        if (fh.magic != REPLAY_FRAME_MAGIC || (m_frames > 0 && fh.frame != m_last_frame + 1)) {
+            m_pos = m_size;
+            return false;
+        }
+        size_t body = static_cast<size_t>(fh.count) * sizeof(ReplayEntry);
+        if (m_pos + sizeof(fh) + body > m_size) {
+            return false;
+        }
+        entries = reinterpret_cast<const ReplayEntry*>(m_base + m_pos + sizeof(fh));
+        m_pos += sizeof(fh) + body;
+        m_last_frame = fh.frame;
+        ++m_frames;
+        return true;
+    }
+
+    void rewind() {
+        m_pos = sizeof(m_header);
+        m_frames = 0;
+    }
+
+private:
+    const char* m_base;
+    size_t m_size;
+    size_t m_pos;
+    uint64_t m_frames;          /// 已读出的帧数
+    uint32_t m_last_frame;
+    ReplayFileHeader m_header;
+};
+
+#endif
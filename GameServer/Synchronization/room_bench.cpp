@@ -0,0 +1,76 @@
+#include <stdlib.h>
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
+
+#include "game_sim.h"
+#include "room_scheduler.h"
+
+/**
+ * 多房间调度基准：大量小房间（每个房间一个 FrameSimulation）复用到固定数量的工作线程上运行，
+ * 其中少数热点房间每帧做更多模拟工作。运行结束后打印各线程利用率、窃取次数和负载最高的房间。
+ * 编译: g++ -std=c++17 -O2 -pthread room_bench.cpp -o room_bench
+ * 运行: ./room_bench [房间数，默认 2000] [工作线程数，默认 CPU 核数] [运行秒数，默认 3]
+*/
+
+#define ROOM_FPS 30
+#define HOT_ROOM_EVERY 100  /// 每 100 个房间中有一个热点房间
+#define HOT_ROOM_STEPS 50   /// 热点房间每帧模拟的步数
+
+class SimRoom : public Room {
+public:
+    SimRoom(int id, int steps) : m_id(id), m_steps(steps) {}
+
+    void tick() override {
+        /// 模拟几个玩家的输入
+        for (uint16_t p = 0; p < 8; ++p) {
+            InputCmd cmd = {m_sim.frame(), OP_MOVE_DIR, 0, static_cast<int16_t>((m_id + p) % 7 - 3), 1};
+            m_sim.apply(p, cmd);
+        }
+        for (int i = 0; i < m_steps; ++i) {
+            m_sim.step();
+        }
+    }
+
+private:
+    int m_id;
+    int m_steps;
+    FrameSimulation m_sim;
+};
+
+int main(int argc, char const *argv[]) {
+    int rooms = argc > 1 ? atoi(argv[1]) : 2000;
+    int workers = argc > 2 ? atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    int seconds = argc > 3 ? atoi(argv[3]) : 3;
+
+    RoomScheduler scheduler(workers);
+    std::vector<std::unique_ptr<SimRoom>> room_list;
+    for (int i = 0; i < rooms; ++i) {
+        room_list.emplace_back(new SimRoom(i, i % HOT_ROOM_EVERY == 0 ? HOT_ROOM_STEPS : 1));
+        scheduler.addRoom(room_list.back().get(), ROOM_FPS);
+    }
+    scheduler.start();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+
+    /// 运行中移除一半房间，模拟对局结束；只移除奇数 id，热点房间（id 是 HOT_ROOM_EVERY 的倍数）留到最后出现在报告里
+    for (int i = 1; i < rooms; i += 2) {
+        scheduler.removeRoom(i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    scheduler.stop();
+
+    uint64_t ticks = 0, skipped = 0;
+    for (int i = 0; i < rooms; ++i) {
+        RoomStats st = {};
+        scheduler.roomStats(i, st);
+        ticks += st.ticks;
+        skipped += st.skipped;
+    }
+    std::cout << rooms << " rooms at " << ROOM_FPS << " fps on " << workers << " workers: "
+              << ticks << " ticks, " << skipped << " skipped" << std::endl;
+    scheduler.report(std::cout, 5);
+    return 0;
+}
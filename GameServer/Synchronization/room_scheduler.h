@@ -0,0 +1,334 @@
+#ifndef __ROOM_SCHEDULER_H__
+#define __ROOM_SCHEDULER_H__
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+/**
+ * 多房间调度器：把大量房间（每个房间一个独立的世界）复用到固定数量的工作线程上
+ *
+ * 每个工作线程有一个按下次 tick 截止时间排序的最小堆，到期的房间出堆、执行 tick()、按固定步长算出下一个截止时间后重新入堆，
+ * 没有到期房间时 wait_until 睡到最早的截止时间，不再是一个房间一个睡眠线程。
+ * 工作窃取：某个线程空闲而另一个线程堆顶的房间已经超期（说明那个线程正忙于别的房间），空闲线程把该房间偷过来，
+ * 之后由它负责调度，热点房间就会逐渐分散到不同的核上。同一时刻一个房间只在一个堆里或只被一个线程执行，tick() 不会并发。
+ * 每个房间记录 tick 耗时（EWMA、最大值、总和）和因超时跳过的 tick 数，addRoom 按各线程的估算负载（耗时 x 帧率）选择放置位置。
+*/
+
+/// 可被调度的房间，tick() 推进一帧
+class Room {
+public:
+    virtual ~Room() {}
+    virtual void tick() = 0;
+};
+
+struct RoomStats {
+    int worker;                 /// 当前负责的工作线程
+    int fps;
+    uint64_t ticks;
+    uint64_t skipped;           /// 超时错过、直接跳过的 tick 数
+    uint64_t avg_cost_ns;       /// tick 耗时的指数移动平均（权重 1/8）
+    uint64_t max_cost_ns;
+    uint64_t total_cost_ns;
+};
+
+class RoomScheduler {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    /// 空闲线程最多睡这么久就去尝试窃取一次
+    static const int64_t STEAL_POLL_NS = 1000000;
+    /// 堆顶房间超期超过该值才允许被窃取，避免和刚醒来的属主线程抢
+    static const int64_t STEAL_GRACE_NS = 200000;
+    /// 还没有耗时样本的房间按该耗时估算负载
+    static const int64_t DEFAULT_COST_NS = 10000;
+
+    explicit RoomScheduler(int workers) : m_running(false), m_start_ns(nowNs()) {
+        for (int i = 0; i < std::max(workers, 1); ++i) {
+            m_workers.emplace_back(new Worker());
+        }
+    }
+
+    ~RoomScheduler() { stop(); }
+
+    void start() {
+        m_running = true;
+        m_start_ns = nowNs();
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            m_workers[i]->thread = std::thread(&RoomScheduler::workerLoop, this, static_cast<int>(i));
+        }
+    }
+
+    void stop() {
+        m_running = false;
+        for (auto& w : m_workers) {
+            {
+                std::lock_guard<std::mutex> lock(w->mutex);
+            }
+            w->cv.notify_all();
+        }
+        for (auto& w : m_workers) {
+            if (w->thread.joinable()) {
+                w->thread.join();
+            }
+        }
+    }
+
+    /// 添加房间，放到估算负载最小的工作线程上，返回房间 id（不会复用）；room 由调用方管理，需活到 removeRoom 之后
+    int addRoom(Room* room, int fps) {
+        std::lock_guard<std::mutex> reg(m_registry_mutex);
+        int id = static_cast<int>(m_slots.size());
+        m_slots.emplace_back(new Slot(room, fps));
+        Slot* slot = m_slots.back().get();
+
+        std::vector<uint64_t> load(m_workers.size(), 0);
+        for (const auto& s : m_slots) {
+            if (s.get() != slot && !s->removed.load(std::memory_order_relaxed)) {
+                uint64_t cost = s->ewma_ns.load(std::memory_order_relaxed);
+                load[s->worker.load(std::memory_order_relaxed)] += (cost != 0 ? cost : DEFAULT_COST_NS) * s->fps;
+            }
+        }
+        int w = static_cast<int>(std::min_element(load.begin(), load.end()) - load.begin());
+        slot->worker.store(w, std::memory_order_relaxed);
+
+        /// 错开同帧率房间的初始相位，避免所有房间在同一时刻到期
+        int64_t phase = static_cast<int64_t>((static_cast<uint64_t>(id) * 2654435761u) % slot->interval_ns);
+        push(w, Entry{nowNs() + phase, slot});
+        return id;
+    }
+
+    /// 移除房间，返回时保证该房间的 tick() 不在执行、之后也不会再被调用
+    void removeRoom(int id) {
+        Slot* slot = getSlot(id);
+        if (slot == nullptr) {
+            return;
+        }
+        slot->removed.store(true);
+        while (slot->ticking.load()) {
+            std::this_thread::yield();
+        }
+    }
+
+    bool roomStats(int id, RoomStats& stats) const {
+        const Slot* slot = getSlot(id);
+        if (slot == nullptr) {
+            return false;
+        }
+        stats.worker = slot->worker.load(std::memory_order_relaxed);
+        stats.fps = slot->fps;
+        stats.ticks = slot->ticks.load(std::memory_order_relaxed);
+        stats.skipped = slot->skipped.load(std::memory_order_relaxed);
+        stats.avg_cost_ns = slot->ewma_ns.load(std::memory_order_relaxed);
+        stats.max_cost_ns = slot->max_ns.load(std::memory_order_relaxed);
+        stats.total_cost_ns = slot->total_ns.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    /// 打印各工作线程的利用率和负载最高的 top_n 个房间
+    void report(std::ostream& os, size_t top_n = 10) const {
+        std::vector<std::pair<uint64_t, int>> hot;
+        std::vector<int> rooms(m_workers.size(), 0);
+        {
+            std::lock_guard<std::mutex> reg(m_registry_mutex);
+            for (size_t i = 0; i < m_slots.size(); ++i) {
+                const Slot& s = *m_slots[i];
+                if (s.removed.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+                ++rooms[s.worker.load(std::memory_order_relaxed)];
+                hot.emplace_back(s.ewma_ns.load(std::memory_order_relaxed) * s.fps, static_cast<int>(i));
+            }
+        }
+        int64_t elapsed = nowNs() - m_start_ns;
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            const Worker& w = *m_workers[i];
+            uint64_t busy = w.busy_ns.load(std::memory_order_relaxed);
+            os << "worker " << i << ": " << rooms[i] << " rooms, " << w.ticks.load(std::memory_order_relaxed)
+               << " ticks, busy " << (elapsed > 0 ? 100.0 * busy / elapsed : 0.0) << "%, stole "
+               << w.steals.load(std::memory_order_relaxed) << " rooms\n";
+        }
+
+        top_n = std::min(top_n, hot.size());
+        std::partial_sort(hot.begin(), hot.begin() + top_n, hot.end(), std::greater<std::pair<uint64_t, int>>());
+        for (size_t i = 0; i < top_n; ++i) {
+            RoomStats st = {};
+            roomStats(hot[i].second, st);
+            os << "room " << hot[i].second << " on worker " << st.worker << ": " << st.fps << " fps, avg "
+               << st.avg_cost_ns << " ns, max " << st.max_cost_ns << " ns, " << st.ticks << " ticks, "
+               << st.skipped << " skipped, load " << hot[i].first / 1000 << " us/s\n";
+        }
+    }
+
+private:
+    struct Slot {
+        Slot(Room* r, int f)
+            : room(r), fps(f), interval_ns(1000000000LL / std::max(f, 1)), worker(0),
+              removed(false), ticking(false), ticks(0), skipped(0), ewma_ns(0), max_ns(0), total_ns(0) {}
+
+        Room* room;
+        int fps;
+        int64_t interval_ns;
+        std::atomic<int> worker;
+        std::atomic<bool> removed;
+        std::atomic<bool> ticking;
+        /// 以下指标只由当前执行该房间的线程写入，其他线程只读
+        std::atomic<uint64_t> ticks;
+        std::atomic<uint64_t> skipped;
+        std::atomic<uint64_t> ewma_ns;
+        std::atomic<uint64_t> max_ns;
+        std::atomic<uint64_t> total_ns;
+    };
+
+    struct Entry {
+        int64_t deadline;
+        Slot* slot;
+
+        bool operator>(const Entry& rhs) const { return deadline > rhs.deadline; }
+    };
+
+    struct alignas(64) Worker {
+        Worker() : top(INT64_MAX), busy_ns(0), ticks(0), steals(0) {}
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<Entry> heap;        /// 最小堆，受 mutex 保护
+        std::atomic<int64_t> top;       /// 堆顶截止时间，供其他线程不加锁地判断能否窃取
+        std::thread thread;
+        std::atomic<uint64_t> busy_ns;
+        std::atomic<uint64_t> ticks;
+        std::atomic<uint64_t> steals;
+    };
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+    }
+
+    Slot* getSlot(int id) const {
+        std::lock_guard<std::mutex> reg(m_registry_mutex);
+        return id >= 0 && static_cast<size_t>(id) < m_slots.size() ? m_slots[id].get() : nullptr;
+    }
+
+    void push(int w, const Entry& e) {
+        Worker& worker = *m_workers[w];
+        bool earliest;
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.heap.push_back(e);
+            std::push_heap(worker.heap.begin(), worker.heap.end(), std::greater<Entry>());
+            earliest = worker.heap.front().slot == e.slot;
+            worker.top.store(worker.heap.front().deadline, std::memory_order_relaxed);
+        }
+        if (earliest) {
+            worker.cv.notify_one();
+        }
+    }
+
+    /// 调用方持有 worker.mutex
+    static Entry popLocked(Worker& worker) {
+        std::pop_heap(worker.heap.begin(), worker.heap.end(), std::greater<Entry>());
+        Entry e = worker.heap.back();
+        worker.heap.pop_back();
+        worker.top.store(worker.heap.empty() ? INT64_MAX : worker.heap.front().deadline, std::memory_order_relaxed);
+        return e;
+    }
+
+    /// 从其他线程的堆里偷一个已经超期的房间
+    bool steal(int self, int64_t now, Entry& e) {
+        int n = static_cast<int>(m_workers.size());
+        for (int i = 1; i < n; ++i) {
+            Worker& victim = *m_workers[(self + i) % n];
+            if (victim.top.load(std::memory_order_relaxed) > now - STEAL_GRACE_NS) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.heap.empty() && victim.heap.front().deadline <= now - STEAL_GRACE_NS) {
+                e = popLocked(victim);
+                e.slot->worker.store(self, std::memory_order_relaxed);
+                m_workers[self]->steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(int self) {
+        Worker& worker = *m_workers[self];
+        while (m_running) {
+            int64_t now = nowNs();
+            Entry e;
+            bool got = false;
+            {
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                if (!worker.heap.empty() && worker.heap.front().deadline <= now) {
+                    e = popLocked(worker);
+                    got = true;
+                }
+            }
+            if (!got && m_workers.size() > 1) {
+                got = steal(self, now, e);
+            }
+            if (!got) {
+                std::unique_lock<std::mutex> lock(worker.mutex);
+                int64_t wake = std::min(worker.top.load(std::memory_order_relaxed), now + STEAL_POLL_NS);
+                if (m_running && wake > now) {
+                    worker.cv.wait_until(lock, clock::time_point(std::chrono::nanoseconds(wake)));
+                }
+                continue;
+            }
+            runTick(self, e);
+        }
+    }
+
+    void runTick(int self, const Entry& e) {
+        Slot* slot = e.slot;
+        /// 与 removeRoom 配对：先标记正在执行再检查是否已移除
+        slot->ticking.store(true);
+        if (slot->removed.load()) {
+            slot->ticking.store(false);
+            return;
+        }
+
+        int64_t start = nowNs();
+        slot->room->tick();
+        int64_t end = nowNs();
+        uint64_t cost = static_cast<uint64_t>(end - start);
+
+        uint64_t ewma = slot->ewma_ns.load(std::memory_order_relaxed);
+        slot->ewma_ns.store(ewma == 0 ? cost : ewma - ewma / 8 + cost / 8, std::memory_order_relaxed);
+        if (cost > slot->max_ns.load(std::memory_order_relaxed)) {
+            slot->max_ns.store(cost, std::memory_order_relaxed);
+        }
+        slot->total_ns.fetch_add(cost, std::memory_order_relaxed);
+        slot->ticks.fetch_add(1, std::memory_order_relaxed);
+        Worker& worker = *m_workers[self];
+        worker.busy_ns.fetch_add(cost, std::memory_order_relaxed);
+        worker.ticks.fetch_add(1, std::memory_order_relaxed);
+
+        /// 按固定步长推进截止时间；已经错过的 tick 直接跳过，对齐到下一个未来的截止时间
+        int64_t next = e.deadline + slot->interval_ns;
+        if (next <= end) {
+            int64_t missed = (end - next) / slot->interval_ns + 1;
+            slot->skipped.fetch_add(missed, std::memory_order_relaxed);
+            next += missed * slot->interval_ns;
+        }
+        push(self, Entry{next, slot});
+        slot->ticking.store(false);
+    }
+
+    std::atomic<bool> m_running;
+    int64_t m_start_ns;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::unique_ptr<Slot>> m_slots;
+    mutable std::mutex m_registry_mutex;
+};
+
+#endif
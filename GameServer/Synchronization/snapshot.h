@@ -0,0 +1,280 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/**
+ * 状态同步的增量快照
+ *
+ * 每个客户端只收到其兴趣区域（AOI）内的实体，并且以该客户端最后确认（ack）的快照为基线做增量编码：
+ *   - 基线中已有的实体：每个字段 1 位标记是否变化，变化的字段写 zigzag 后的差值；
+ *   - 新进入视野的实体：写完整状态；
+ *   - 离开视野的实体：只写 id。
+ * 整数用变长位编码（BitWriter::writeVar），小的差值只占几个位。
+ * 基线不可用（从未确认或已被挤出历史）时退化为完整快照，客户端依然可以正确解码。
+ * 带宽与客户端实际能看到、且发生变化的实体数成正比，而不是玩家数的平方。
+*/
+
+#define SNAPSHOT_HISTORY 32     /// 每个客户端保留的已发送快照数
+
+/// 量化后的实体状态
+struct EntityState {
+    int32_t x;
+    int32_t y;
+};
+
+/// 一个快照：按 id 升序排列的可见实体
+struct Snapshot {
+    uint32_t seq = 0;
+    std::vector<std::pair<int, EntityState>> entities;
+};
+
+inline uint32_t zigzag(int32_t v) {
+    return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+inline int32_t unzigzag(uint32_t v) {
+    return static_cast<int32_t>((v >> 1) ^ (~(v & 1) + 1));
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out), m_acc(0), m_nbits(0) {}
+
+    void writeBits(uint32_t v, int n) {
+        m_acc |= static_cast<uint64_t>(v) << m_nbits;
+        m_nbits += n;
+        while (m_nbits >= 8) {
+            m_out.push_back(static_cast<uint8_t>(m_acc));
+            m_acc >>= 8;
+            m_nbits -= 8;
+        }
+    }
+
+    /// 0 写 1 位；其他值写 1 位标记 + 5 位有效位数 + 有效位
+    void writeVar(uint32_t v) {
+        if (v == 0) {
+            writeBits(0, 1);
+            return;
+        }
+        int len = 32 - __builtin_clz(v);
+        writeBits(1, 1);
+        writeBits(len - 1, 5);
+        writeBits(v, len);
+    }
+
+    void flush() {
+        if (m_nbits > 0) {
+            m_out.push_back(static_cast<uint8_t>(m_acc));
+            m_acc = 0;
+            m_nbits = 0;
+        }
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_acc;
+    int m_nbits;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t len) : m_data(data), m_len(len), m_pos(0), m_acc(0), m_nbits(0), m_error(false) {}
+
+    uint32_t readBits(int n) {
+        while (m_nbits < n) {
+            if (m_pos >= m_len) {
+                m_error = true;
+                return 0;
+            }
+            m_acc |= static_cast<uint64_t>(m_data[m_pos++]) << m_nbits;
+            m_nbits += 8;
+        }
+        uint32_t v = static_cast<uint32_t>(m_acc & ((1ULL << n) - 1));
+        m_acc >>= n;
+        m_nbits -= n;
+        return v;
+    }
+
+    uint32_t readVar() {
+        if (readBits(1) == 0) {
+            return 0;
+        }
+        int len = static_cast<int>(readBits(5)) + 1;
+        return readBits(len);
+    }
+
+    bool error() const { return m_error; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_len;
+    size_t m_pos;
+    uint64_t m_acc;
+    int m_nbits;
+    bool m_error;
+};
+
+/// 已发送或已接收快照的历史，按 seq 取模存放
+class SnapshotHistory {
+public:
+    void put(const Snapshot& snap) { m_snaps[snap.seq % SNAPSHOT_HISTORY] = snap; }
+
+    /// seq 对应的快照仍在历史中时返回它，否则返回 nullptr
+    const Snapshot* get(uint32_t seq) const {
+        const Snapshot& s = m_snaps[seq % SNAPSHOT_HISTORY];
+        return seq != 0 && s.seq == seq ? &s : nullptr;
+    }
+
+private:
+    Snapshot m_snaps[SNAPSHOT_HISTORY];
+};
+
+/**
+ * 以 baseline 为基线编码 snap，baseline 为空时编码完整快照
+ * 格式：seq(32) baseline_seq(32) var(present) {var(id_gap) bit(in_base) fields...}* var(removed) {var(id_gap)}*
+*/
+inline void encodeSnapshot(const Snapshot& snap, const Snapshot* baseline, std::vector<uint8_t>& out) {
+    static const Snapshot empty;
+    const Snapshot& base = baseline != nullptr ? *baseline : empty;
+    BitWriter w(out);
+    w.writeBits(snap.seq, 32);
+    w.writeBits(baseline != nullptr ? baseline->seq : 0, 32);
+    w.writeVar(static_cast<uint32_t>(snap.entities.size()));
+
+    /// 两个有序列表做归并：找出共有的、新增的和移除的实体
+    std::vector<int> removed;
+    size_t bi = 0;
+    int prev_id = -1;
+    for (const auto& ent : snap.entities) {
+        while (bi < base.entities.size() && base.entities[bi].first < ent.first) {
+            removed.push_back(base.entities[bi++].first);
+        }
+        w.writeVar(static_cast<uint32_t>(ent.first - prev_id - 1));
+        prev_id = ent.first;
+        if (bi < base.entities.size() && base.entities[bi].first == ent.first) {
+            const EntityState& old = base.entities[bi++].second;
+            w.writeBits(1, 1);
+            int32_t dx = ent.second.x - old.x;
+            int32_t dy = ent.second.y - old.y;
+            w.writeBits(dx != 0, 1);
+            if (dx != 0) {
+                w.writeVar(zigzag(dx));
+            }
+            w.writeBits(dy != 0, 1);
+            if (dy != 0) {
+                w.writeVar(zigzag(dy));
+            }
+        } else {
+            w.writeBits(0, 1);
+            w.writeVar(zigzag(ent.second.x));
+            w.writeVar(zigzag(ent.second.y));
+        }
+    }
+    while (bi < base.entities.size()) {
+        removed.push_back(base.entities[bi++].first);
+    }
+
+    w.writeVar(static_cast<uint32_t>(removed.size()));
+    prev_id = -1;
+    for (int id : removed) {
+        w.writeVar(static_cast<uint32_t>(id - prev_id - 1));
+        prev_id = id;
+    }
+    w.flush();
+}
+
+/**
+ * 客户端解码：需要的基线从 history 中取，解码出的完整快照写入 snap
+ * 基线缺失或数据损坏时返回 false
+*/
+inline bool decodeSnapshot(const uint8_t* data, size_t len, const SnapshotHistory& history, Snapshot& snap) {
+    static const Snapshot empty;
+    BitReader r(data, len);
+    snap.seq = r.readBits(32);
+    uint32_t base_seq = r.readBits(32);
+    const Snapshot* base = &empty;
+    if (base_seq != 0) {
+        base = history.get(base_seq);
+        if (base == nullptr) {
+            return false;
+        }
+    }
+
+    uint32_t present = r.readVar();
+    snap.entities.clear();
+    int prev_id = -1;
+    size_t bi = 0;
+    for (uint32_t i = 0; i < present && !r.error(); ++i) {
+        int id = prev_id + 1 + static_cast<int>(r.readVar());
+        prev_id = id;
+        EntityState st;
+        if (r.readBits(1)) {
+            while (bi < base->entities.size() && base->entities[bi].first < id) {
+                ++bi;
+            }
+            if (bi >= base->entities.size() || base->entities[bi].first != id) {
+                return false;
+            }
+            st = base->entities[bi].second;
+            if (r.readBits(1)) {
+                st.x += unzigzag(r.readVar());
+            }
+            if (r.readBits(1)) {
+                st.y += unzigzag(r.readVar());
+            }
+        } else {
+            st.x = unzigzag(r.readVar());
+            st.y = unzigzag(r.readVar());
+        }
+        snap.entities.emplace_back(id, st);
+    }
+
+    /// 移除列表只用于校验：可见集合已经由 present 部分完整给出
+    uint32_t removed = r.readVar();
+    for (uint32_t i = 0; i < removed && !r.error(); ++i) {
+        r.readVar();
+    }
+    return !r.error();
+}
+
+/**
+ * 服务器端每个客户端的视图：记录已发送的快照和客户端确认的最新序号
+*/
+class ClientView {
+public:
+    ClientView() : m_next_seq(1), m_acked(0) {}
+
+    /// 为该客户端生成下一个快照并编码到 out
+    void buildAndEncode(std::vector<std::pair<int, EntityState>>&& visible, std::vector<uint8_t>& out) {
+        Snapshot snap;
+        snap.seq = m_next_seq++;
+        snap.entities = std::move(visible);
+        std::sort(snap.entities.begin(), snap.entities.end(),
+                  [](const std::pair<int, EntityState>& a, const std::pair<int, EntityState>& b) {
+                      return a.first < b.first;
+                  });
+        encodeSnapshot(snap, m_history.get(m_acked), out);
+        m_history.put(snap);
+    }
+
+    /// 客户端确认收到 seq 号快照，之后以它为基线
+    void ack(uint32_t seq) {
+        if (seq > m_acked && seq < m_next_seq) {
+            m_acked = seq;
+        }
+    }
+
+    uint32_t acked() const { return m_acked; }
+
+private:
+    uint32_t m_next_seq;
+    uint32_t m_acked;
+    SnapshotHistory m_history;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef __TRIPLE_BUFFER_H__
+#define __TRIPLE_BUFFER_H__
+
+#include <stdint.h>
+
+#include <atomic>
+
+/**
+ * 无锁三缓冲：一个写者（模拟线程）和一个读者（广播线程）
+ *
+ * 写者总在 back 缓冲上写，写完调用 publish()，用一次原子交换把 back 和中间缓冲对调，
+ * 读者调用 update() 时如果中间缓冲有新数据，再用一次原子交换把它换到 front。
+ * 双方都不会等待对方：写者不必等广播结束才能写下一帧，读者读到的 front 在下一次 update() 之前不会被修改。
+ * 缓冲对象在交换中被复用，vector 等容器的容量会保留下来，稳定运行后不再分配内存。
+*/
+
+template <class T>
+class TripleBuffer {
+public:
+    TripleBuffer() : m_back(0), m_middle(1), m_front(2) {}
+
+    /// 写者：当前可写的缓冲，内容是之前某一帧的旧数据，需要完整覆盖
+    T& back() { return m_bufs[m_back]; }
+
+    /// 写者：发布 back 缓冲，并取回一个空闲缓冲作为新的 back
+    void publish() {
+        m_back = m_middle.exchange(m_back | NEW_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    /// 读者：如果有新发布的数据则切换 front，返回是否切换
+    bool update() {
+        if ((m_middle.load(std::memory_order_relaxed) & NEW_BIT) == 0) {
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    /// 读者：最近一次 update() 得到的不可变数据
+    const T& front() const { return m_bufs[m_front]; }
+
+private:
+    static const uint8_t NEW_BIT = 0x4;
+    static const uint8_t INDEX_MASK = 0x3;
+
+    T m_bufs[3];
+    alignas(64) uint8_t m_back;             /// 只由写者访问
+    alignas(64) std::atomic<uint8_t> m_middle;
+    alignas(64) uint8_t m_front;            /// 只由读者访问
+};
+
+#endif
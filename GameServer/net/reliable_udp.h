@@ -0,0 +1,843 @@
+#ifndef __RELIABLE_UDP_H__
+#define __RELIABLE_UDP_H__
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 面向游戏流量的 UDP 可靠传输层
+ *
+ * 包格式（小端）：
+ *   u32 conn_id | u16 seq | u16 ack | u32 ack_bits | u8 flags | 若干帧 { u8 channel | u8 flags | u16 msg_seq | u16 len | payload }
+ *   包头 flags 的 PACKET_HAS_ACK 位表示 ack / ack_bits 有效：还没收到过对方的包时不能确认任何包
+ * - 连接 ID：按 conn_id 而不是源地址区分连接，客户端 NAT 重新映射端口后连接不断，服务器更新对端地址即可；
+ * - 选择确认：每个包都捎带最大收到的包号 ack 和它之前 32 个包的位图 ack_bits，一个包丢失不会拖住其他包的确认；
+ * - 通道：每个通道可配置为不可靠、可靠无序、可靠有序。可靠性以消息为单位，包丢失后只重传其中的可靠消息，
+ *   有序通道只在本通道内按序交付，不同通道之间、以及无序通道都没有队头阻塞；
+ *   待发消息按通道分别排队，某个可靠通道的发送窗口满时只有该通道停下，其他通道照常发送；
+ *   每个可靠通道在途（未确认）的消息不超过 RECV_WINDOW 条，保证对方的接收窗口放得下；
+ *   接收端收到放不进接收窗口的可靠消息时整个包按未收到处理，不确认，由发送端重传；
+ * - 丢包判定：比它晚发送的包已有 3 个被确认，或超过 RTO（按 RFC 6298 由 srtt/rttvar 计算）；
+ * - 拥塞控制：按字节计的 AIMD 拥塞窗口（慢启动 + 拥塞避免，每个 RTT 最多减半一次），
+ *   发送按 1.25 * cwnd / srtt 的速率均匀 pacing，不会把一个窗口的数据一次突发出去；
+ * - 批量 I/O：接收用 recvmmsg 一次取多个包，发送先攒在本轮的发送表里再用一次 sendmmsg 发出；
+ *   内核支持 UDP GSO 时，发往同一连接的连续满长度包合并成一个 UDP_SEGMENT 超级包（总长不超过 UDP 上限），由内核/网卡分段。
+ * 消息不分片，单条消息不超过 MAX_MESSAGE_SIZE。整个 Endpoint 只能在一个线程里使用。
+*/
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+namespace rudp {
+
+static const size_t MTU = 1200;                 /// 单个 UDP 负载上限，保守地避开路径 MTU 问题
+static const size_t PACKET_HEADER_SIZE = 13;
+static const uint8_t PACKET_HAS_ACK = 0x01;
+static const size_t FRAME_HEADER_SIZE = 6;
+static const size_t MAX_MESSAGE_SIZE = MTU - PACKET_HEADER_SIZE - FRAME_HEADER_SIZE;
+static const int MAX_CHANNELS = 8;
+static const int SENT_WINDOW = 1024;            /// 跟踪的在途包数上限
+static const int RECV_WINDOW = 1024;            /// 每个可靠通道的接收窗口（消息数）
+static const size_t MAX_PENDING = 4096;         /// 每个连接排队未发的消息上限
+static const int IO_BATCH = 64;                 /// 每次 recvmmsg/sendmmsg 的包数
+static const int GSO_MAX_SEGMENTS = 64;
+static const size_t GSO_MAX_BYTES = 65507;      /// 一个 GSO 超级包仍是一个 UDP 报文，总长受 64 KiB 限制
+static const int LOSS_REORDER_THRESHOLD = 3;
+static const int64_t ACK_DELAY_NS = 5000000;    /// 没有数据可捎带时，纯 ACK 最多延迟 5ms
+static const int64_t INITIAL_RTT_NS = 100000000;
+static const int64_t MIN_RTO_NS = 20000000;
+static const int64_t MAX_RTO_NS = 2000000000;
+static const int64_t IDLE_TIMEOUT_NS = 10000000000LL;
+static const uint32_t INITIAL_CWND = 10 * MTU;
+static const uint32_t MIN_CWND = 2 * MTU;
+
+enum class ChannelType : uint8_t {
+    Unreliable,
+    ReliableUnordered,
+    ReliableOrdered,
+};
+
+inline int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// 16 位序号的回绕比较：a 是否比 b 新
+inline bool seq_greater(uint16_t a, uint16_t b) {
+    return static_cast<int16_t>(a - b) > 0;
+}
+
+inline void store_u16(uint8_t* p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+inline void store_u32(uint8_t* p, uint32_t v) {
+    store_u16(p, static_cast<uint16_t>(v));
+    store_u16(p + 2, static_cast<uint16_t>(v >> 16));
+}
+
+inline uint16_t load_u16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t load_u32(const uint8_t* p) {
+    return load_u16(p) | (static_cast<uint32_t>(load_u16(p + 2)) << 16);
+}
+
+struct ConnectionStats {
+    uint64_t packets_sent = 0;
+    uint64_t packets_received = 0;
+    uint64_t packets_lost = 0;          /// 判定为丢失的包数
+    uint64_t retransmits = 0;           /// 重传的消息数
+    uint64_t messages_sent = 0;
+    uint64_t messages_delivered = 0;
+    int64_t srtt_ns = 0;
+    uint32_t cwnd = 0;
+};
+
+class Endpoint;
+
+class Connection {
+public:
+    uint32_t id() const { return m_id; }
+    const sockaddr_in& peer() const { return m_peer; }
+    const ConnectionStats& stats() const { return m_stats; }
+
+    /// 在 channel 上发送一条消息，实际发出发生在下一次 Endpoint::update()
+    /// 消息过长、通道不存在或排队过多时返回 false
+    bool send(int channel, const void* data, size_t len);
+
+private:
+    friend class Endpoint;
+
+    struct Message {
+        uint8_t channel;
+        uint16_t seq;
+        bool reliable;
+        bool queued;            /// 已在重传队列中
+        std::vector<uint8_t> data;
+    };
+
+    struct SentPacket {
+        bool in_flight = false;
+        uint16_t seq = 0;
+        int64_t time = 0;
+        uint32_t bytes = 0;
+        std::vector<uint32_t> messages;     /// 携带的可靠消息（channel << 16 | msg_seq）
+    };
+
+    /// 可靠通道的发送窗口：base 之前的消息都已被确认，只发出 [base, base + RECV_WINDOW) 之内的消息，
+    /// 对方接收窗口的下沿不会落后于 base，因此发出的消息一定放得进对方的接收窗口
+    struct SendChannel {
+        uint16_t base = 0;
+        bool acked[RECV_WINDOW] = {};
+    };
+
+    /// 可靠通道的接收窗口：base 之前的消息都已交付，[base, base + RECV_WINDOW) 之内的按位记录
+    struct RecvChannel {
+        uint16_t base = 0;
+        bool received[RECV_WINDOW] = {};
+        std::vector<uint8_t> buffered[RECV_WINDOW];     /// 有序通道中先到的消息
+    };
+
+    Connection(Endpoint* ep, uint32_t id, const sockaddr_in& peer, int64_t now);
+
+    static uint32_t key(uint8_t channel, uint16_t seq) { return (static_cast<uint32_t>(channel) << 16) | seq; }
+
+    int64_t rto() const {
+        int64_t rto = (m_srtt + 4 * m_rttvar + ACK_DELAY_NS) << m_backoff;
+        return rto < MIN_RTO_NS ? MIN_RTO_NS : (rto > MAX_RTO_NS ? MAX_RTO_NS : rto);
+    }
+
+    bool hasData() const { return !m_retransmit.empty() || m_pending_count != 0; }
+
+    bool canSend(int64_t now) const {
+        return hasData() && now >= m_pacing_next && !m_sent[m_next_seq % SENT_WINDOW].in_flight
+               && (m_bytes_in_flight == 0 || m_bytes_in_flight + MTU <= m_cwnd);
+    }
+
+    bool ackDue(int64_t now) const {
+        return m_ack_pending && (m_unacked_received >= 2 || now - m_ack_pending_since >= ACK_DELAY_NS);
+    }
+
+    void onPacket(const uint8_t* data, size_t len, const sockaddr_in& from, int64_t now);
+    void onAck(uint16_t ack, uint32_t bits, int64_t now);
+    void onPacketAcked(SentPacket& p);
+    void onMessageAcked(uint32_t k);
+    bool inSendWindow(const Message& msg) const;
+    bool acceptable(uint8_t channel, uint16_t msg_seq) const;
+    void detectLoss(int64_t now);
+    void deliver(uint8_t channel, uint16_t msg_seq, const uint8_t* data, size_t len);
+    void dispatch(uint8_t channel, const uint8_t* data, size_t len);
+    size_t buildPacket(uint8_t* out, int64_t now);
+
+    Endpoint* m_ep;
+    uint32_t m_id;
+    sockaddr_in m_peer;
+    int64_t m_last_recv;
+    ConnectionStats m_stats;
+
+    /// 发送端
+    uint16_t m_next_seq = 0;
+    uint16_t m_next_msg_seq[MAX_CHANNELS] = {};
+    std::deque<Message> m_pending[MAX_CHANNELS];     /// 每个通道各自排队，互不阻塞
+    size_t m_pending_count = 0;
+    int m_next_channel = 0;             /// 组包时从这个通道开始取，轮流保证公平
+    std::deque<uint32_t> m_retransmit;
+    std::unordered_map<uint32_t, Message> m_unacked;
+    std::unique_ptr<SendChannel> m_send_window[MAX_CHANNELS];
+    SentPacket m_sent[SENT_WINDOW];
+    std::deque<uint16_t> m_sent_order;
+    bool m_has_acked = false;
+    uint16_t m_largest_acked = 0;
+
+    /// 拥塞控制和 pacing
+    uint32_t m_cwnd = INITIAL_CWND;
+    uint32_t m_ssthresh = UINT32_MAX;
+    uint32_t m_bytes_in_flight = 0;
+    int64_t m_recovery_start = 0;
+    int64_t m_srtt = INITIAL_RTT_NS;
+    int64_t m_rttvar = INITIAL_RTT_NS / 2;
+    bool m_has_rtt = false;
+    int m_backoff = 0;                  /// 连续超时的次数，RTO 按 2 的幂退避
+    int64_t m_pacing_next = 0;
+
+    /// 接收端
+    bool m_has_remote = false;
+    uint16_t m_remote_seq = 0;
+    uint32_t m_remote_bits = 0;
+    bool m_ack_pending = false;
+    int64_t m_ack_pending_since = 0;
+    int m_unacked_received = 0;
+    std::unique_ptr<RecvChannel> m_recv[MAX_CHANNELS];
+};
+
+class Endpoint {
+public:
+    typedef std::function<void(Connection& conn, int channel, const uint8_t* data, size_t len)> MessageCallback;
+    typedef std::function<void(Connection& conn)> ConnectionCallback;
+
+    explicit Endpoint(const std::vector<ChannelType>& channels)
+        : m_channels(channels), m_fd(-1), m_accept(false), m_gso(false), m_loss_rate(0), m_rng(std::random_device()()),
+          m_out_count(0) {
+        if (m_channels.size() > static_cast<size_t>(MAX_CHANNELS)) {
+            m_channels.resize(MAX_CHANNELS);
+        }
+        m_out.resize(IO_BATCH * 4);
+        for (int i = 0; i < IO_BATCH; ++i) {
+            m_rx_iov[i].iov_base = m_rx_bufs[i];
+            m_rx_iov[i].iov_len = sizeof(m_rx_bufs[i]);
+        }
+    }
+
+    ~Endpoint() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    /// 绑定本地端口（0 表示由内核分配），accept 为 true 时接受未知 conn_id 的新连接（服务器）
+    bool bind(uint16_t port, bool accept) {
+        m_fd = socket(PF_INET, SOCK_DGRAM, 0);
+        if (m_fd < 0) {
+            return false;
+        }
+        fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (::bind(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+            close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+        m_accept = accept;
+        /// 探测内核是否支持 UDP GSO（Linux 4.18+）
+        int seg = 0;
+        socklen_t seg_len = sizeof(seg);
+        m_gso = getsockopt(m_fd, SOL_UDP, UDP_SEGMENT, &seg, &seg_len) == 0;
+        return true;
+    }
+
+    int fd() const { return m_fd; }
+    bool gsoEnabled() const { return m_gso; }
+
+    uint16_t port() const {
+        sockaddr_in addr = {};
+        socklen_t len = sizeof(addr);
+        getsockname(m_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+        return ntohs(addr.sin_port);
+    }
+
+    ChannelType channelType(int channel) const { return m_channels[channel]; }
+    int channelCount() const { return static_cast<int>(m_channels.size()); }
+
+    void onMessage(MessageCallback cb) { m_on_message = std::move(cb); }
+    void onConnect(ConnectionCallback cb) { m_on_connect = std::move(cb); }
+    void onDisconnect(ConnectionCallback cb) { m_on_disconnect = std::move(cb); }
+
+    /// 测试用：按比例随机丢弃发出的包
+    void setLossRate(double rate) { m_loss_rate = rate; }
+
+    /// 客户端发起连接：随机选取连接 ID，第一个包到达服务器时连接即建立
+    Connection* connect(const sockaddr_in& peer) {
+        uint32_t id;
+        do {
+            id = static_cast<uint32_t>(m_rng());
+        } while (id == 0 || m_conns.count(id) != 0);
+        Connection* conn = new Connection(this, id, peer, now_ns());
+        m_conns[id].reset(conn);
+        return conn;
+    }
+
+    /// 用 recvmmsg 取出所有已到达的包并处理，返回处理的包数
+    int receive(int64_t now) {
+        int total = 0;
+        for (;;) {
+            mmsghdr msgs[IO_BATCH];
+            sockaddr_in addrs[IO_BATCH];
+            for (int i = 0; i < IO_BATCH; ++i) {
+                memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+                msgs[i].msg_hdr.msg_name = &addrs[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+                msgs[i].msg_hdr.msg_iov = &m_rx_iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int n = recvmmsg(m_fd, msgs, IO_BATCH, MSG_DONTWAIT, NULL);
+            if (n <= 0) {
+                break;
+            }
+            for (int i = 0; i < n; ++i) {
+                onDatagram(m_rx_bufs[i], msgs[i].msg_len, addrs[i], now);
+            }
+            total += n;
+            if (n < IO_BATCH) {
+                break;
+            }
+        }
+        return total;
+    }
+
+    /// 处理超时重传、按拥塞窗口和 pacing 组包，最后批量发出；需要周期性调用（例如每 1ms）
+    void update(int64_t now) {
+        for (auto it = m_conns.begin(); it != m_conns.end();) {
+            Connection& conn = *it->second;
+            if (now - conn.m_last_recv > IDLE_TIMEOUT_NS) {
+                if (m_on_disconnect) {
+                    m_on_disconnect(conn);
+                }
+                dropQueued(&conn);
+                it = m_conns.erase(it);
+                continue;
+            }
+            conn.detectLoss(now);
+            while (conn.canSend(now) || conn.ackDue(now)) {
+                if (m_out_count == m_out.size()) {
+                    flush();
+                }
+                OutDatagram& out = m_out[m_out_count];
+                out.len = conn.buildPacket(out.data, now);
+                if (out.len == 0) {
+                    break;
+                }
+                out.conn = &conn;
+                if (m_loss_rate > 0 && std::uniform_real_distribution<double>(0, 1)(m_rng) < m_loss_rate) {
+                    continue;
+                }
+                ++m_out_count;
+            }
+            ++it;
+        }
+        flush();
+    }
+
+    size_t connectionCount() const { return m_conns.size(); }
+
+private:
+    friend class Connection;
+
+    struct OutDatagram {
+        Connection* conn;
+        size_t len;
+        uint8_t data[MTU];
+    };
+
+    void onDatagram(const uint8_t* data, size_t len, const sockaddr_in& from, int64_t now) {
+        if (len < PACKET_HEADER_SIZE) {
+            return;
+        }
+        uint32_t id = load_u32(data);
+        auto it = m_conns.find(id);
+        Connection* conn;
+        if (it != m_conns.end()) {
+            conn = it->second.get();
+        } else {
+            if (!m_accept || id == 0) {
+                return;
+            }
+            conn = new Connection(this, id, from, now);
+            m_conns[id].reset(conn);
+            if (m_on_connect) {
+                m_on_connect(*conn);
+            }
+        }
+        conn->onPacket(data, len, from, now);
+    }
+
+    void dropQueued(Connection* conn) {
+        size_t n = 0;
+        for (size_t i = 0; i < m_out_count; ++i) {
+            if (m_out[i].conn != conn) {
+                std::swap(m_out[n++], m_out[i]);
+            }
+        }
+        m_out_count = n;
+    }
+
+    /// 用 sendmmsg 发出本轮所有包；开启 GSO 时，发往同一连接的连续满长度包合并成一个 UDP_SEGMENT 消息
+    void flush() {
+        size_t i = 0;
+        while (i < m_out_count) {
+            mmsghdr msgs[IO_BATCH];
+            iovec iovs[IO_BATCH * GSO_MAX_SEGMENTS / 8];
+            char control[IO_BATCH][CMSG_SPACE(sizeof(uint16_t))];
+            size_t niov = 0, start = i;
+            int nmsg = 0;
+            while (i < m_out_count && nmsg < IO_BATCH) {
+                size_t seg = m_out[i].len;
+                size_t j = i;
+                if (m_gso) {
+                    while (j + 1 < m_out_count && j + 1 - i < static_cast<size_t>(GSO_MAX_SEGMENTS)
+                           && (j + 2 - i) * seg <= GSO_MAX_BYTES
+                           && niov + (j + 1 - i) < sizeof(iovs) / sizeof(iovs[0])
+                           && m_out[j + 1].conn == m_out[i].conn && m_out[j].len == seg && m_out[j + 1].len <= seg) {
+                        ++j;
+                    }
+                }
+                if (niov + (j - i + 1) > sizeof(iovs) / sizeof(iovs[0])) {
+                    break;
+                }
+                msghdr& hdr = msgs[nmsg].msg_hdr;
+                memset(&hdr, 0, sizeof(hdr));
+                hdr.msg_name = &m_out[i].conn->m_peer;
+                hdr.msg_namelen = sizeof(sockaddr_in);
+                hdr.msg_iov = &iovs[niov];
+                hdr.msg_iovlen = j - i + 1;
+                for (size_t k = i; k <= j; ++k) {
+                    iovs[niov].iov_base = m_out[k].data;
+                    iovs[niov].iov_len = m_out[k].len;
+                    ++niov;
+                }
+                if (j > i) {
+                    hdr.msg_control = control[nmsg];
+                    hdr.msg_controllen = sizeof(control[nmsg]);
+                    cmsghdr* cm = CMSG_FIRSTHDR(&hdr);
+                    cm->cmsg_level = SOL_UDP;
+                    cm->cmsg_type = UDP_SEGMENT;
+                    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                    uint16_t seg16 = static_cast<uint16_t>(seg);
+                    memcpy(CMSG_DATA(cm), &seg16, sizeof(seg16));
+                }
+                ++nmsg;
+                i = j + 1;
+            }
+
+            int sent = 0;
+            while (sent < nmsg) {
+                int n = sendmmsg(m_fd, msgs + sent, nmsg - sent, 0);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    if (m_gso && (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP || errno == EMSGSIZE)) {
+                        /// 网卡不支持校验和卸载、超级包过长等原因导致 GSO 失败，关闭后从失败的那个消息开始逐包重发
+                        m_gso = false;
+                        i = start;
+                        for (int k = 0; k < sent; ++k) {
+                            i += msgs[k].msg_hdr.msg_iovlen;
+                        }
+                        break;
+                    }
+                    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                        /// 发送缓冲区满：丢弃剩余的包，由可靠层重传
+                        sent = nmsg;
+                        break;
+                    }
+                    /// 只与这个目的地址有关的错误（如 ECONNREFUSED）：跳过这一个消息，继续发其余的
+                    ++sent;
+                    continue;
+                }
+                sent += n;
+            }
+        }
+        m_out_count = 0;
+    }
+
+    std::vector<ChannelType> m_channels;
+    int m_fd;
+    bool m_accept;
+    bool m_gso;
+    double m_loss_rate;
+    std::mt19937 m_rng;
+    std::unordered_map<uint32_t, std::unique_ptr<Connection>> m_conns;
+    MessageCallback m_on_message;
+    ConnectionCallback m_on_connect;
+    ConnectionCallback m_on_disconnect;
+
+    /// 预分配的收发缓冲区
+    uint8_t m_rx_bufs[IO_BATCH][2048];
+    iovec m_rx_iov[IO_BATCH];
+    std::vector<OutDatagram> m_out;
+    size_t m_out_count;
+};
+
+inline Connection::Connection(Endpoint* ep, uint32_t id, const sockaddr_in& peer, int64_t now)
+    : m_ep(ep), m_id(id), m_peer(peer), m_last_recv(now) {
+    for (int i = 0; i < ep->channelCount(); ++i) {
+        if (ep->channelType(i) != ChannelType::Unreliable) {
+            m_send_window[i].reset(new SendChannel());
+            m_recv[i].reset(new RecvChannel());
+        }
+    }
+    m_stats.cwnd = m_cwnd;
+    m_stats.srtt_ns = m_srtt;
+}
+
+inline bool Connection::send(int channel, const void* data, size_t len) {
+    if (channel < 0 || channel >= m_ep->channelCount() || len > MAX_MESSAGE_SIZE || m_pending_count >= MAX_PENDING) {
+        return false;
+    }
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    Message msg;
+    msg.channel = static_cast<uint8_t>(channel);
+    msg.seq = m_next_msg_seq[channel]++;
+    msg.reliable = m_ep->channelType(channel) != ChannelType::Unreliable;
+    msg.queued = false;
+    msg.data.assign(p, p + len);
+    m_pending[channel].push_back(std::move(msg));
+    ++m_pending_count;
+    ++m_stats.messages_sent;
+    return true;
+}
+
+inline size_t Connection::buildPacket(uint8_t* out, int64_t now) {
+    uint16_t seq = m_next_seq;
+    store_u32(out, m_id);
+    store_u16(out + 4, seq);
+    store_u16(out + 6, m_remote_seq);
+    store_u32(out + 8, m_remote_bits);
+    out[12] = m_has_remote ? PACKET_HAS_ACK : 0;
+    size_t pos = PACKET_HEADER_SIZE;
+    /// 不能发数据时（窗口满、pacing 未到）只发纯 ACK，不能动可能仍在途的 m_sent 槽位
+    bool can_carry = canSend(now);
+    SentPacket& sp = m_sent[seq % SENT_WINDOW];
+    if (can_carry) {
+        sp.messages.clear();
+    }
+    auto write = [&](const Message& msg) {
+        out[pos] = msg.channel;
+        out[pos + 1] = 0;
+        store_u16(out + pos + 2, msg.seq);
+        store_u16(out + pos + 4, static_cast<uint16_t>(msg.data.size()));
+        memcpy(out + pos + FRAME_HEADER_SIZE, msg.data.data(), msg.data.size());
+        pos += FRAME_HEADER_SIZE + msg.data.size();
+    };
+    /// 先放重传的消息，再放新消息
+    while (can_carry && !m_retransmit.empty()) {
+        auto it = m_unacked.find(m_retransmit.front());
+        if (it == m_unacked.end() || !it->second.queued) {
+            m_retransmit.pop_front();
+            continue;
+        }
+        if (pos + FRAME_HEADER_SIZE + it->second.data.size() > MTU) {
+            break;
+        }
+        write(it->second);
+        it->second.queued = false;
+        sp.messages.push_back(it->first);
+        m_retransmit.pop_front();
+        ++m_stats.retransmits;
+    }
+    int channels = m_ep->channelCount();
+    for (int n = 0; can_carry && m_pending_count != 0 && n < channels; ++n) {
+        std::deque<Message>& queue = m_pending[(m_next_channel + n) % channels];
+        while (!queue.empty()) {
+            Message& msg = queue.front();
+            /// 队首的可靠消息超出本通道发送窗口时只停下这个通道，等前面的消息被确认后再发
+            if (pos + FRAME_HEADER_SIZE + msg.data.size() > MTU || !inSendWindow(msg)) {
+                break;
+            }
+            write(msg);
+            if (msg.reliable) {
+                uint32_t k = key(msg.channel, msg.seq);
+                sp.messages.push_back(k);
+                m_unacked[k] = std::move(msg);
+            }
+            queue.pop_front();
+            --m_pending_count;
+        }
+    }
+    if (can_carry && channels > 0) {
+        m_next_channel = (m_next_channel + 1) % channels;
+    }
+
+    if (pos == PACKET_HEADER_SIZE && !m_ack_pending) {
+        return 0;
+    }
+    m_ack_pending = false;
+    m_unacked_received = 0;
+    ++m_next_seq;
+    ++m_stats.packets_sent;
+    if (pos > PACKET_HEADER_SIZE) {
+        /// 只有携带数据的包计入在途字节并参与丢包判定，纯 ACK 包发出即忘
+        sp.in_flight = true;
+        sp.seq = seq;
+        sp.time = now;
+        sp.bytes = static_cast<uint32_t>(pos);
+        m_sent_order.push_back(seq);
+        m_bytes_in_flight += sp.bytes;
+        int64_t interval = static_cast<int64_t>(static_cast<double>(pos) * m_srtt / (1.25 * m_cwnd));
+        m_pacing_next = (m_pacing_next > now ? m_pacing_next : now) + interval;
+    }
+    return pos;
+}
+
+inline void Connection::onPacket(const uint8_t* data, size_t len, const sockaddr_in& from, int64_t now) {
+    uint16_t seq = load_u16(data + 4);
+    m_last_recv = now;
+    ++m_stats.packets_received;
+    if (data[12] & PACKET_HAS_ACK) {
+        onAck(load_u16(data + 6), load_u32(data + 8), now);
+    }
+
+    /// 重复包和太旧的包只处理其中的确认信息
+    bool newest = !m_has_remote || seq_greater(seq, m_remote_seq);
+    uint16_t back = static_cast<uint16_t>(m_remote_seq - seq);
+    if (!newest && (back == 0 || back > 32 || (m_remote_bits & (1u << (back - 1))) != 0)) {
+        return;
+    }
+
+    /// 先检查整个包：有可靠消息放不进接收窗口时整包按未收到处理，既不交付也不确认，
+    /// 否则这个包被确认后发送端不会再重传其中的消息，有序通道会永远停在这里
+    size_t end = PACKET_HEADER_SIZE;
+    while (end + FRAME_HEADER_SIZE <= len) {
+        uint8_t channel = data[end];
+        size_t msg_len = load_u16(data + end + 4);
+        if (channel >= m_ep->channelCount() || end + FRAME_HEADER_SIZE + msg_len > len) {
+            break;
+        }
+        if (!acceptable(channel, load_u16(data + end + 2))) {
+            return;
+        }
+        end += FRAME_HEADER_SIZE + msg_len;
+    }
+
+    /// 更新本端要回给对方的 ack / ack_bits
+    if (!m_has_remote) {
+        m_has_remote = true;
+        m_remote_seq = seq;
+        m_remote_bits = 0;
+    } else if (newest) {
+        uint16_t shift = static_cast<uint16_t>(seq - m_remote_seq);
+        uint64_t bits = shift >= 33 ? 0 : ((static_cast<uint64_t>(m_remote_bits) << shift) | (1ULL << (shift - 1)));
+        m_remote_bits = static_cast<uint32_t>(bits);
+        m_remote_seq = seq;
+    } else {
+        m_remote_bits |= 1u << (back - 1);
+    }
+    /// 连接迁移：同一个连接 ID 从新地址到达时更新对端地址；只跟随比之前收到的都新的包，
+    /// 延迟或重复到达的旧包不会把地址改回去
+    if (newest) {
+        m_peer = from;
+    }
+
+    size_t pos = PACKET_HEADER_SIZE;
+    while (pos < end) {
+        uint8_t channel = data[pos];
+        uint16_t msg_seq = load_u16(data + pos + 2);
+        size_t msg_len = load_u16(data + pos + 4);
+        deliver(channel, msg_seq, data + pos + FRAME_HEADER_SIZE, msg_len);
+        pos += FRAME_HEADER_SIZE + msg_len;
+    }
+    if (pos > PACKET_HEADER_SIZE) {
+        if (!m_ack_pending) {
+            m_ack_pending = true;
+            m_ack_pending_since = now;
+        }
+        ++m_unacked_received;
+    }
+}
+
+/// 可靠消息能否被接收窗口接纳：窗口之内，或者落后于窗口（已交付消息的重复，确认它无害）
+inline bool Connection::acceptable(uint8_t channel, uint16_t msg_seq) const {
+    if (m_ep->channelType(channel) == ChannelType::Unreliable) {
+        return true;
+    }
+    uint16_t offset = static_cast<uint16_t>(msg_seq - m_recv[channel]->base);
+    return offset < RECV_WINDOW || offset >= 0x8000;
+}
+
+inline bool Connection::inSendWindow(const Message& msg) const {
+    return !msg.reliable || static_cast<uint16_t>(msg.seq - m_send_window[msg.channel]->base) < RECV_WINDOW;
+}
+
+inline void Connection::deliver(uint8_t channel, uint16_t msg_seq, const uint8_t* data, size_t len) {
+    ChannelType type = m_ep->channelType(channel);
+    if (type == ChannelType::Unreliable) {
+        dispatch(channel, data, len);
+        return;
+    }
+
+    RecvChannel& rc = *m_recv[channel];
+    uint16_t offset = static_cast<uint16_t>(msg_seq - rc.base);
+    /// offset 超出窗口只可能是已交付消息的重复（超前的消息在 onPacket 中已整包拒绝）
+    if (offset >= RECV_WINDOW || rc.received[msg_seq % RECV_WINDOW]) {
+        return;
+    }
+    rc.received[msg_seq % RECV_WINDOW] = true;
+    bool ordered = type == ChannelType::ReliableOrdered;
+    if (ordered && offset != 0) {
+        /// 有序通道中先到的消息缓存起来，等前面的消息到齐
+        rc.buffered[msg_seq % RECV_WINDOW].assign(data, data + len);
+        return;
+    }
+    dispatch(channel, data, len);
+
+    /// 推进窗口下沿；有序通道顺带交付已经连续的缓存消息
+    while (rc.received[rc.base % RECV_WINDOW]) {
+        if (ordered && rc.base != msg_seq) {
+            std::vector<uint8_t>& buf = rc.buffered[rc.base % RECV_WINDOW];
+            dispatch(channel, buf.data(), buf.size());
+            buf.clear();
+        }
+        rc.received[rc.base % RECV_WINDOW] = false;
+        ++rc.base;
+    }
+}
+
+inline void Connection::dispatch(uint8_t channel, const uint8_t* data, size_t len) {
+    ++m_stats.messages_delivered;
+    if (m_ep->m_on_message) {
+        m_ep->m_on_message(*this, channel, data, len);
+    }
+}
+
+inline void Connection::onPacketAcked(SentPacket& p) {
+    for (uint32_t k : p.messages) {
+        /// 重传过的消息可能被两个包确认，只在第一次确认时推进发送窗口
+        if (m_unacked.erase(k) != 0) {
+            onMessageAcked(k);
+        }
+    }
+    p.in_flight = false;
+    m_bytes_in_flight -= p.bytes;
+    /// 慢启动阶段每确认一个字节窗口加一个字节，拥塞避免阶段每个 RTT 约增加一个 MTU
+    if (m_cwnd < m_ssthresh) {
+        m_cwnd += p.bytes;
+    } else {
+        m_cwnd += static_cast<uint32_t>(static_cast<uint64_t>(MTU) * p.bytes / m_cwnd) + 1;
+    }
+    m_stats.cwnd = m_cwnd;
+}
+
+inline void Connection::onMessageAcked(uint32_t k) {
+    SendChannel& sc = *m_send_window[k >> 16];
+    sc.acked[(k & 0xffff) % RECV_WINDOW] = true;
+    while (sc.acked[sc.base % RECV_WINDOW]) {
+        sc.acked[sc.base % RECV_WINDOW] = false;
+        ++sc.base;
+    }
+}
+
+inline void Connection::onAck(uint16_t ack, uint32_t bits, int64_t now) {
+    for (int i = 0; i <= 32; ++i) {
+        if (i > 0 && (bits & (1u << (i - 1))) == 0) {
+            continue;
+        }
+        uint16_t seq = static_cast<uint16_t>(ack - i);
+        SentPacket& p = m_sent[seq % SENT_WINDOW];
+        if (!p.in_flight || p.seq != seq) {
+            continue;
+        }
+        if (i == 0) {
+            /// 用最大确认包的往返时间更新 srtt/rttvar（RFC 6298）
+            int64_t rtt = now - p.time;
+            if (!m_has_rtt) {
+                m_srtt = rtt;
+                m_rttvar = rtt / 2;
+                m_has_rtt = true;
+            } else {
+                int64_t err = rtt > m_srtt ? rtt - m_srtt : m_srtt - rtt;
+                m_rttvar += (err - m_rttvar) / 4;
+                m_srtt += (rtt - m_srtt) / 8;
+            }
+            m_stats.srtt_ns = m_srtt;
+        }
+        if (!m_has_acked || seq_greater(seq, m_largest_acked)) {
+            m_largest_acked = seq;
+            m_has_acked = true;
+        }
+        m_backoff = 0;
+        onPacketAcked(p);
+    }
+    detectLoss(now);
+}
+
+inline void Connection::detectLoss(int64_t now) {
+    int64_t timeout = rto();
+    /// m_sent_order 按发送顺序排列，越靠前越老：遇到第一个既未确认也未判定丢失的包即可停止
+    while (!m_sent_order.empty()) {
+        uint16_t seq = m_sent_order.front();
+        SentPacket& p = m_sent[seq % SENT_WINDOW];
+        if (p.in_flight && p.seq == seq) {
+            bool reordered = m_has_acked && static_cast<int16_t>(m_largest_acked - seq) >= LOSS_REORDER_THRESHOLD;
+            if (!reordered && now - p.time < timeout) {
+                break;
+            }
+            p.in_flight = false;
+            m_bytes_in_flight -= p.bytes;
+            ++m_stats.packets_lost;
+            for (uint32_t k : p.messages) {
+                auto it = m_unacked.find(k);
+                if (it != m_unacked.end() && !it->second.queued) {
+                    it->second.queued = true;
+                    m_retransmit.push_back(k);
+                }
+            }
+            /// 每个 RTT 最多减半一次：只对恢复期开始之后发出的包做出反应
+            if (p.time > m_recovery_start) {
+                m_ssthresh = m_cwnd / 2 > MIN_CWND ? m_cwnd / 2 : MIN_CWND;
+                m_cwnd = m_ssthresh;
+                m_recovery_start = now;
+                m_stats.cwnd = m_cwnd;
+            }
+            if (!reordered && m_backoff < 6) {
+                /// 超时意味着对方可能长时间没有回包，RTO 退避
+                ++m_backoff;
+            }
+        }
+        m_sent_order.pop_front();
+    }
+}
+
+}   // namespace rudp
+
+#endif
@@ -0,0 +1,284 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <deque>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "reliable_udp.h"
+
+/**
+ * 基于可靠 UDP 层的回声服务器/客户端（对应 TCP-IP-networking-programming/chapter_6 的 uecho_server/uecho_client）
+ * 通道 0 可靠有序、通道 1 不可靠、通道 2 可靠无序，服务器把每条消息原样从同一通道发回。
+ * 客户端在通道 0 上发送带序号和发送时间戳的消息，校验回声严格按序且一条不少，并统计往返延迟和重传。
+ * 编译: g++ -std=c++17 -O2 rudp_echo.cpp -o rudp_echo
+ * 运行: ./rudp_echo server <port> [丢包率%]
+ *       ./rudp_echo client <ip> <port> [消息数，默认 20000] [丢包率%]
+ *       ./rudp_echo                    同一进程内跑服务器和客户端，双向各模拟 10% 丢包
+ *                                      （之前先做两项回归检查：发往不可达地址不卡住 update，可靠通道停滞不阻塞其他通道）
+*/
+
+#define CH_ORDERED 0
+#define CH_UNRELIABLE 1
+#define CH_UNORDERED 2
+
+static const std::vector<rudp::ChannelType> g_channels = {
+    rudp::ChannelType::ReliableOrdered,
+    rudp::ChannelType::Unreliable,
+    rudp::ChannelType::ReliableUnordered,
+};
+
+struct EchoMsg {
+    uint32_t index;
+    int64_t sent_ns;
+};
+
+/// 连接的发送队列满（MAX_PENDING）时 send 返回 false，回声先存起来，之后按原顺序重试，不能跳过
+struct EchoBacklog {
+    rudp::Connection* conn;
+    std::deque<std::pair<int, std::vector<uint8_t>>> msgs;
+};
+
+typedef std::unordered_map<uint32_t, EchoBacklog> ServerState;
+
+static void serve(rudp::Endpoint& server, ServerState& state) {
+    server.onConnect([](rudp::Connection& conn) {
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &conn.peer().sin_addr, ip, sizeof(ip));
+        printf("connection %08x from %s:%d\n", conn.id(), ip, ntohs(conn.peer().sin_port));
+    });
+    server.onDisconnect([&state](rudp::Connection& conn) {
+        state.erase(conn.id());
+        const rudp::ConnectionStats& st = conn.stats();
+        printf("connection %08x closed: %lu messages, %lu retransmits\n", conn.id(),
+               (unsigned long)st.messages_delivered, (unsigned long)st.retransmits);
+    });
+    server.onMessage([&state](rudp::Connection& conn, int channel, const uint8_t* data, size_t len) {
+        auto it = state.find(conn.id());
+        if ((it == state.end() || it->second.msgs.empty()) && conn.send(channel, data, len)) {
+            return;
+        }
+        EchoBacklog& backlog = state[conn.id()];
+        backlog.conn = &conn;
+        backlog.msgs.emplace_back(channel, std::vector<uint8_t>(data, data + len));
+    });
+}
+
+/// 在每次 update 之前重试积压的回声
+static void retryEchoes(ServerState& state) {
+    for (auto& entry : state) {
+        EchoBacklog& backlog = entry.second;
+        while (!backlog.msgs.empty()) {
+            const std::pair<int, std::vector<uint8_t>>& msg = backlog.msgs.front();
+            if (!backlog.conn->send(msg.first, msg.second.data(), msg.second.size())) {
+                break;
+            }
+            backlog.msgs.pop_front();
+        }
+    }
+}
+
+struct ClientState {
+    uint32_t sent = 0;
+    uint32_t next_echo = 0;
+    bool out_of_order = false;
+    uint64_t unreliable_echoes = 0;
+    int64_t rtt_sum_ns = 0;
+    int64_t rtt_max_ns = 0;
+};
+
+static void setupClient(rudp::Endpoint& client, ClientState& state) {
+    client.onMessage([&state](rudp::Connection&, int channel, const uint8_t* data, size_t len) {
+        if (channel == CH_UNRELIABLE) {
+            ++state.unreliable_echoes;
+            return;
+        }
+        EchoMsg msg;
+        if (channel != CH_ORDERED || len < sizeof(msg)) {
+            return;
+        }
+        memcpy(&msg, data, sizeof(msg));
+        if (msg.index != state.next_echo) {
+            state.out_of_order = true;
+        }
+        ++state.next_echo;
+        int64_t rtt = rudp::now_ns() - msg.sent_ns;
+        state.rtt_sum_ns += rtt;
+        state.rtt_max_ns = rtt > state.rtt_max_ns ? rtt : state.rtt_max_ns;
+    });
+}
+
+/// 每毫秒发一批消息，直到全部发出且收齐回声
+static void clientStep(rudp::Connection& conn, ClientState& state, uint32_t total) {
+    for (int i = 0; i < 64 && state.sent < total; ++i) {
+        EchoMsg msg = {state.sent, rudp::now_ns()};
+        if (!conn.send(CH_ORDERED, &msg, sizeof(msg))) {
+            break;
+        }
+        conn.send(CH_UNRELIABLE, &msg, sizeof(msg));
+        ++state.sent;
+    }
+}
+
+static void printResult(const rudp::Connection& conn, const ClientState& state, uint32_t total, int64_t elapsed_ns) {
+    const rudp::ConnectionStats& st = conn.stats();
+    printf("%u/%u ordered echoes %s in %.1f ms, avg rtt %.2f ms, max rtt %.2f ms\n",
+           state.next_echo, total, state.out_of_order ? "OUT OF ORDER" : "in order", elapsed_ns / 1e6,
+           state.next_echo ? state.rtt_sum_ns / 1e6 / state.next_echo : 0.0, state.rtt_max_ns / 1e6);
+    printf("unreliable echoes %lu, packets sent %lu, lost %lu, retransmits %lu, srtt %.2f ms, cwnd %u\n",
+           (unsigned long)state.unreliable_echoes, (unsigned long)st.packets_sent, (unsigned long)st.packets_lost,
+           (unsigned long)st.retransmits, st.srtt_ns / 1e6, st.cwnd);
+}
+
+/// 发往 255.255.255.255（socket 未开 SO_BROADCAST，sendmmsg 返回 EACCES）：update() 必须跳过出错的包并返回
+static bool checkUnreachablePeer() {
+    rudp::Endpoint ep(g_channels);
+    if (!ep.bind(0, false)) {
+        return false;
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    addr.sin_port = htons(9);
+    rudp::Connection* conn = ep.connect(addr);
+    EchoMsg msg = {0, 0};
+    for (int i = 0; i < 100; ++i) {
+        conn->send(CH_ORDERED, &msg, sizeof(msg));
+        conn->send(CH_UNRELIABLE, &msg, sizeof(msg));
+        ep.update(rudp::now_ns());
+    }
+    printf("unreachable peer: update returned, %lu packets attempted\n", (unsigned long)conn->stats().packets_sent);
+    return true;
+}
+
+/// 服务器发出的包（包括 ACK）全部丢弃，客户端可靠有序通道发满一个接收窗口后停滞；
+/// 排在后面的不可靠消息仍要送达，不能被停滞的通道挡住
+static bool checkChannelIsolation() {
+    rudp::Endpoint server(g_channels), client(g_channels);
+    if (!server.bind(0, true) || !client.bind(0, false)) {
+        return false;
+    }
+    server.setLossRate(1.0);
+    uint32_t reliable = 0, unreliable = 0;
+    server.onMessage([&](rudp::Connection&, int channel, const uint8_t*, size_t) {
+        ++(channel == CH_UNRELIABLE ? unreliable : reliable);
+    });
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    addr.sin_port = htons(server.port());
+    rudp::Connection* conn = client.connect(addr);
+    uint8_t byte = 0;
+    for (int i = 0; i < rudp::RECV_WINDOW + 100; ++i) {
+        conn->send(CH_ORDERED, &byte, 1);
+    }
+    const uint32_t total = 20;
+    for (uint32_t i = 0; i < total; ++i) {
+        conn->send(CH_UNRELIABLE, &byte, 1);
+    }
+    int64_t start = rudp::now_ns();
+    while (unreliable < total && rudp::now_ns() - start < 1000000000LL) {
+        pollfd pfd = {server.fd(), POLLIN, 0};
+        poll(&pfd, 1, 1);
+        int64_t now = rudp::now_ns();
+        server.receive(now);
+        client.update(now);
+        server.update(now);
+    }
+    printf("stalled reliable channel: %u reliable (window %d), %u/%u unreliable delivered\n",
+           reliable, rudp::RECV_WINDOW, unreliable, total);
+    return reliable <= static_cast<uint32_t>(rudp::RECV_WINDOW) && unreliable == total;
+}
+
+int main(int argc, char const *argv[])
+{
+    if (argc >= 3 && strcmp(argv[1], "server") == 0) {
+        rudp::Endpoint server(g_channels);
+        if (!server.bind(atoi(argv[2]), true)) {
+            perror("bind");
+            return 1;
+        }
+        server.setLossRate(argc > 3 ? atof(argv[3]) / 100 : 0);
+        ServerState server_state;
+        serve(server, server_state);
+        printf("listening on %d, gso %s\n", server.port(), server.gsoEnabled() ? "on" : "off");
+        pollfd pfd = {server.fd(), POLLIN, 0};
+        for (;;) {
+            poll(&pfd, 1, 1);
+            int64_t now = rudp::now_ns();
+            server.receive(now);
+            retryEchoes(server_state);
+            server.update(now);
+        }
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "client") == 0) {
+        rudp::Endpoint client(g_channels);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        inet_pton(AF_INET, argv[2], &addr.sin_addr);
+        addr.sin_port = htons(atoi(argv[3]));
+        uint32_t total = argc > 4 ? atoi(argv[4]) : 20000;
+        if (!client.bind(0, false)) {
+            perror("bind");
+            return 1;
+        }
+        client.setLossRate(argc > 5 ? atof(argv[5]) / 100 : 0);
+        ClientState state;
+        setupClient(client, state);
+        rudp::Connection* conn = client.connect(addr);
+        pollfd pfd = {client.fd(), POLLIN, 0};
+        int64_t start = rudp::now_ns();
+        while (state.next_echo < total && rudp::now_ns() - start < 30000000000LL) {
+            clientStep(*conn, state, total);
+            poll(&pfd, 1, 1);
+            int64_t now = rudp::now_ns();
+            client.receive(now);
+            client.update(now);
+        }
+        printResult(*conn, state, total, rudp::now_ns() - start);
+        return state.next_echo == total && !state.out_of_order ? 0 : 1;
+    }
+
+    if (!checkUnreachablePeer() || !checkChannelIsolation()) {
+        printf("regression check failed\n");
+        return 1;
+    }
+
+    /// 本地自测：两个端点在同一线程里交替收发，双向都模拟丢包
+    rudp::Endpoint server(g_channels), client(g_channels);
+    if (!server.bind(0, true) || !client.bind(0, false)) {
+        perror("bind");
+        return 1;
+    }
+    server.setLossRate(0.1);
+    client.setLossRate(0.1);
+    ServerState server_state;
+    serve(server, server_state);
+    ClientState state;
+    setupClient(client, state);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    addr.sin_port = htons(server.port());
+    rudp::Connection* conn = client.connect(addr);
+    printf("gso %s\n", server.gsoEnabled() ? "on" : "off");
+
+    const uint32_t total = 20000;
+    pollfd pfds[2] = {{server.fd(), POLLIN, 0}, {client.fd(), POLLIN, 0}};
+    int64_t start = rudp::now_ns();
+    while (state.next_echo < total && rudp::now_ns() - start < 30000000000LL) {
+        clientStep(*conn, state, total);
+        poll(pfds, 2, 1);
+        int64_t now = rudp::now_ns();
+        server.receive(now);
+        client.receive(now);
+        retryEchoes(server_state);
+        server.update(now);
+        client.update(now);
+    }
+    printResult(*conn, state, total, rudp::now_ns() - start);
+    return state.next_echo == total && !state.out_of_order ? 0 : 1;
+}
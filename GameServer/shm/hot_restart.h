@@ -0,0 +1,250 @@
+#ifndef __HOT_RESTART_H__
+#define __HOT_RESTART_H__
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <vector>
+
+/**
+ * 游戏服务器热重启：新进程接管旧进程的 socket 和共享内存中的游戏状态
+ *
+ * 流程（控制通道是一个 Unix 域 socket）：
+ *   1. 旧进程在控制 socket 上监听；
+ *   2. 新进程启动后连接控制 socket，发送 TakeoverRequest（携带自己的布局版本）；
+ *   3. 旧进程在帧边界停下帧循环，把帧号等写入共享内存，然后用 SCM_RIGHTS
+ *      把监听 socket 和所有客户连接 socket 发送给新进程，同时附带每个连接的玩家槽位；
+ *   4. 新进程 attach 共享内存并校验布局头，成功后回复 ACK，随后从共享内存记录的帧号继续帧循环；
+ *   5. 旧进程收到 ACK 后直接退出（不删除共享内存、不关闭客户连接）；没有收到 ACK 则恢复运行。
+ * 客户端的 TCP 连接自始至终没有断开，最多只感受到一两帧的停顿。
+*/
+
+namespace hot_restart {
+
+static const uint32_t HR_MAGIC = 0x48525354;    /// "HRST"
+static const size_t HR_FDS_PER_MSG = 200;       /// 单条消息携带的 fd 数，需小于内核的 SCM_MAX_FD(253)
+
+struct TakeoverRequest {
+    uint32_t magic;
+    uint32_t layout_version;    /// 新进程期望的共享内存布局版本
+};
+
+/// 旧进程交接时发送的描述，随后是若干条携带 fd 的消息
+struct HandoffHeader {
+    uint32_t magic;
+    uint32_t accepted;          /// 0 表示旧进程拒绝交接（例如布局不兼容）
+    uint64_t frame;             /// 交接时的帧号
+    uint32_t nfds;              /// fd 总数：第 0 个为监听 socket，其余为客户连接
+    uint32_t reserved;
+};
+
+struct HandoffAck {
+    uint32_t magic;
+    uint32_t ok;
+};
+
+/// 完整发送 len 字节，对阻塞 socket 使用
+inline bool write_all(int sock, const void* buf, size_t len) {
+    const char* p = static_cast<const char*>(buf);
+    while (len > 0) {
+        ssize_t n = send(sock, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+inline bool read_all(int sock, void* buf, size_t len) {
+    char* p = static_cast<char*>(buf);
+    while (len > 0) {
+        ssize_t n = recv(sock, p, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * 用 SCM_RIGHTS 发送一组 fd，data 是随 fd 一起发送的数据（至少 1 字节）
+ * 内核会在接收进程中为每个 fd 创建新的描述符，指向同一个打开的文件（socket）
+*/
+inline bool send_fds(int sock, const int* fds, size_t nfds, const void* data, size_t len) {
+    struct iovec iov;
+    iov.iov_base = const_cast<void*>(data);
+    iov.iov_len = len;
+
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * nfds));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return n == static_cast<ssize_t>(len);
+}
+
+/// 接收最多 max_fds 个 fd，返回实际收到的 fd 数，失败返回 -1
+inline int recv_fds(int sock, int* fds, size_t max_fds, void* data, size_t len) {
+    struct iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = len;
+
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * max_fds));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return -1;
+    }
+    /// 即使数据不完整或控制消息被截断，已经到达的 fd 也已经装进了本进程，失败时要逐个关闭
+    bool ok = n == static_cast<ssize_t>(len) && !(msg.msg_flags & MSG_CTRUNC);
+
+    int count = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const unsigned char* data = CMSG_DATA(cmsg);
+            for (int i = 0; i < received; ++i) {
+                int fd;
+                memcpy(&fd, data + i * sizeof(int), sizeof(int));
+                if (ok && static_cast<size_t>(count) < max_fds) {
+                    fds[count++] = fd;
+                } else {
+                    close(fd);
+                }
+            }
+        }
+    }
+    return ok ? count : -1;
+}
+
+inline int make_unix_addr(const char* path, sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+    return sizeof(*addr);
+}
+
+/// 旧进程：创建控制 socket 并监听，失败返回 -1
+inline int listen_control(const char* path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    sockaddr_un addr;
+    socklen_t len = make_unix_addr(path, &addr);
+    unlink(path);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), len) == -1 || listen(fd, 1) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/// 新进程：连接旧进程的控制 socket，没有正在运行的旧进程时返回 -1
+inline int connect_control(const char* path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    sockaddr_un addr;
+    socklen_t len = make_unix_addr(path, &addr);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), len) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * 旧进程：把 fds 和每个 fd 对应的 32 位标签（如玩家槽位）交给新进程
+ * fds[0] 应为监听 socket。返回 true 表示新进程已确认接管
+*/
+inline bool give_fds(int ctrl, uint64_t frame, const std::vector<int>& fds, const std::vector<uint32_t>& tags) {
+    HandoffHeader hdr = {HR_MAGIC, 1, frame, static_cast<uint32_t>(fds.size()), 0};
+    if (!write_all(ctrl, &hdr, sizeof(hdr))) {
+        return false;
+    }
+    for (size_t i = 0; i < fds.size(); i += HR_FDS_PER_MSG) {
+        size_t n = fds.size() - i < HR_FDS_PER_MSG ? fds.size() - i : HR_FDS_PER_MSG;
+        if (!send_fds(ctrl, &fds[i], n, &tags[i], sizeof(uint32_t) * n)) {
+            return false;
+        }
+    }
+    HandoffAck ack;
+    return read_all(ctrl, &ack, sizeof(ack)) && ack.magic == HR_MAGIC && ack.ok == 1;
+}
+
+inline bool reject(int ctrl) {
+    HandoffHeader hdr = {HR_MAGIC, 0, 0, 0, 0};
+    return write_all(ctrl, &hdr, sizeof(hdr));
+}
+
+/// 新进程：发送接管请求并接收全部 fd 与标签，失败返回 false（已收到的 fd 会被关闭）
+inline bool take_fds(int ctrl, uint32_t layout_version, uint64_t* frame,
+                     std::vector<int>* fds, std::vector<uint32_t>* tags) {
+    TakeoverRequest req = {HR_MAGIC, layout_version};
+    HandoffHeader hdr;
+    if (!write_all(ctrl, &req, sizeof(req)) || !read_all(ctrl, &hdr, sizeof(hdr))
+        || hdr.magic != HR_MAGIC || !hdr.accepted) {
+        return false;
+    }
+    fds->resize(hdr.nfds);
+    tags->resize(hdr.nfds);
+    for (size_t i = 0; i < hdr.nfds; i += HR_FDS_PER_MSG) {
+        size_t n = hdr.nfds - i < HR_FDS_PER_MSG ? hdr.nfds - i : HR_FDS_PER_MSG;
+        int got = recv_fds(ctrl, &(*fds)[i], n, &(*tags)[i], sizeof(uint32_t) * n);
+        if (got != static_cast<int>(n)) {
+            for (size_t j = 0; j < i + (got > 0 ? got : 0); ++j) {
+                close((*fds)[j]);
+            }
+            return false;
+        }
+    }
+    *frame = hdr.frame;
+    return true;
+}
+
+inline bool ack(int ctrl, bool ok) {
+    HandoffAck a = {HR_MAGIC, ok ? 1u : 0u};
+    return write_all(ctrl, &a, sizeof(a));
+}
+
+}  // namespace hot_restart
+
+#endif
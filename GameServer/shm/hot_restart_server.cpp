@@ -0,0 +1,330 @@
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <assert.h>
+
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <string>
+
+#include "shm_arena.h"
+#include "hot_restart.h"
+
+/**
+ * 可热重启的帧同步游戏服务器演示
+ *   ./hot_restart_server 9100        第一次启动：冷启动，创建共享内存和监听 socket
+ *   ./hot_restart_server 9100        再次启动（新版本二进制）：从旧进程接管 socket 和玩家状态，旧进程退出
+ * 客户端（如 nc 127.0.0.1 9100）发送 w/a/s/d 改变移动方向，每秒收到一次自己的位置，
+ * 重启过程中连接不断开，帧号和位置连续。
+ * 编译: g++ -std=c++17 -O2 hot_restart_server.cpp -o tests/hot_restart_server -lrt
+*/
+
+#define MAX_EVENT_NUMBER 1024
+#define FPS 20
+
+static const char* g_arena_name = "/HotRestartGame";
+static const char* g_ctrl_path = "/tmp/hot_restart_game.sock";
+
+/// 共享内存布局版本：修改 GameLayout 或 Player 的定义时必须递增，不兼容的新进程会被拒绝
+static const uint32_t LAYOUT_VERSION = 1;
+
+struct Player {
+    float x;
+    float y;
+    int dx;
+    int dy;
+};
+
+static const uint32_t MAX_PLAYERS = 4096;
+typedef shm::FixedPool<Player, MAX_PLAYERS> PlayerPool;
+
+/// 共享内存中的布局头，新进程接管前据此校验
+struct GameLayout {
+    uint32_t version;
+    uint32_t player_size;
+    uint32_t max_players;
+    uint32_t reserved;
+    uint64_t frame;
+    shm::OffsetPtr<PlayerPool> players;
+};
+
+int setnonblocking(int fd) {
+    int old_option = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, old_option | O_NONBLOCK);
+    return old_option;
+}
+
+void addfd(int epollfd, int fd) {
+    epoll_event event;
+    event.data.fd = fd;
+    event.events = EPOLLIN;
+    epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &event);
+    setnonblocking(fd);
+}
+
+bool layout_compatible(const GameLayout* layout) {
+    return layout != nullptr && layout->version == LAYOUT_VERSION && layout->player_size == sizeof(Player)
+           && layout->max_players == MAX_PLAYERS && layout->players;
+}
+
+class GameServer {
+public:
+    GameServer() : m_listenfd(-1), m_ctrlfd(-1), m_layout(nullptr), m_players(nullptr) {}
+
+    /// 冷启动：重建共享内存，创建监听 socket
+    bool cold_start(int port) {
+        shm::Arena::remove(g_arena_name);
+        m_arena.reset(new shm::Arena(shm::Arena::open_or_create(g_arena_name, 4 << 20, 2 << 20)));
+        m_layout = m_arena->construct<GameLayout>();
+        m_players = m_arena->construct<PlayerPool>();
+        if (m_layout == nullptr || m_players == nullptr) {
+            return false;
+        }
+        m_layout->version = LAYOUT_VERSION;
+        m_layout->player_size = sizeof(Player);
+        m_layout->max_players = MAX_PLAYERS;
+        m_layout->frame = 0;
+        m_layout->players = m_players;
+        m_arena->set_root("layout", m_layout);
+
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        m_listenfd = socket(PF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(m_listenfd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1
+            || listen(m_listenfd, 128) == -1) {
+            std::cout << "bind/listen failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+        std::cout << "cold start on port " << port << std::endl;
+        return true;
+    }
+
+    /// 热启动：从旧进程接管 socket，attach 共享内存并校验布局
+    bool take_over(int ctrl) {
+        uint64_t frame = 0;
+        std::vector<int> fds;
+        std::vector<uint32_t> tags;
+        if (!hot_restart::take_fds(ctrl, LAYOUT_VERSION, &frame, &fds, &tags) || fds.empty()) {
+            std::cout << "old server refused takeover" << std::endl;
+            return false;
+        }
+
+        try {
+            m_arena.reset(new shm::Arena(shm::Arena::attach(g_arena_name)));
+        } catch (const std::exception& e) {
+            std::cout << "attach failed: " << e.what() << std::endl;
+        }
+        m_layout = m_arena ? m_arena->find_root<GameLayout>("layout") : nullptr;
+        if (!layout_compatible(m_layout) || m_layout->frame != frame) {
+            std::cout << "shared memory layout mismatch, abort takeover" << std::endl;
+            /// 共享内存仍归旧进程所有：解除映射时不能标记正常退出
+            if (m_arena) {
+                m_arena->detach(false);
+                m_arena.reset();
+            }
+            m_layout = nullptr;
+            hot_restart::ack(ctrl, false);
+            for (int fd : fds) {
+                close(fd);
+            }
+            return false;
+        }
+        m_players = m_layout->players.get();
+
+        m_listenfd = fds[0];
+        for (size_t i = 1; i < fds.size(); ++i) {
+            m_conns[fds[i]] = tags[i];
+        }
+        hot_restart::ack(ctrl, true);
+        std::cout << "took over at frame " << frame << " with " << m_conns.size() << " players" << std::endl;
+        return true;
+    }
+
+    void run() {
+        m_epollfd = epoll_create(5);
+        assert(m_epollfd != -1);
+        addfd(m_epollfd, m_listenfd);
+        for (const auto& conn : m_conns) {
+            addfd(m_epollfd, conn.first);
+        }
+        /// 接管成功后再绑定控制 socket，供下一个版本接管自己
+        m_ctrlfd = hot_restart::listen_control(g_ctrl_path);
+        assert(m_ctrlfd != -1);
+        addfd(m_epollfd, m_ctrlfd);
+
+        typedef std::chrono::steady_clock clock;
+        const auto frame_duration = std::chrono::nanoseconds(1000000000 / FPS);
+        auto deadline = clock::now() + frame_duration;
+        epoll_event events[MAX_EVENT_NUMBER];
+
+        for (;;) {
+            auto now = clock::now();
+            int timeout = now >= deadline ? 0
+                : static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count()) + 1;
+            int number = epoll_wait(m_epollfd, events, MAX_EVENT_NUMBER, timeout);
+            if (number < 0 && errno != EINTR) {
+                std::cout << "epoll failure" << std::endl;
+                break;
+            }
+            for (int i = 0; i < number; ++i) {
+                int sockfd = events[i].data.fd;
+                if (sockfd == m_listenfd) {
+                    accept_player();
+                } else if (sockfd == m_ctrlfd) {
+                    if (hand_off()) {
+                        return;
+                    }
+                } else {
+                    read_input(sockfd);
+                }
+            }
+            if (clock::now() >= deadline) {
+                tick();
+                deadline += frame_duration;
+            }
+        }
+    }
+
+private:
+    void accept_player() {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int connfd = accept(m_listenfd, reinterpret_cast<sockaddr*>(&client_addr), &client_len);
+        if (connfd < 0) {
+            return;
+        }
+        uint32_t slot = m_players->alloc();
+        if (slot == PlayerPool::npos) {
+            const char* info = "server full\n";
+            send(connfd, info, strlen(info), 0);
+            close(connfd);
+            return;
+        }
+        (*m_players)[slot] = Player{0.0f, 0.0f, 0, 0};
+        m_conns[connfd] = slot;
+        addfd(m_epollfd, connfd);
+    }
+
+    void remove_player(int fd) {
+        epoll_ctl(m_epollfd, EPOLL_CTL_DEL, fd, 0);
+        close(fd);
+        m_players->free(m_conns[fd]);
+        m_conns.erase(fd);
+    }
+
+    void read_input(int fd) {
+        char buf[256];
+        int ret = recv(fd, buf, sizeof(buf), 0);
+        if (ret == 0 || (ret < 0 && errno != EAGAIN)) {
+            remove_player(fd);
+            return;
+        }
+        Player* p = m_players->get(m_conns[fd]);
+        for (int i = 0; i < ret && p != nullptr; ++i) {
+            switch (buf[i]) {
+            case 'w': p->dx = 0; p->dy = 1; break;
+            case 's': p->dx = 0; p->dy = -1; break;
+            case 'a': p->dx = -1; p->dy = 0; break;
+            case 'd': p->dx = 1; p->dy = 0; break;
+            default: break;
+            }
+        }
+    }
+
+    /// 帧末状态已在共享内存中，帧号随帧推进写入布局头，所以交接时无需额外序列化
+    void tick() {
+        ++m_layout->frame;
+        m_players->for_each([](uint32_t, Player& p) {
+            p.x += p.dx * 0.1f;
+            p.y += p.dy * 0.1f;
+        });
+        if (m_layout->frame % FPS == 0) {
+            for (const auto& conn : m_conns) {
+                const Player& p = (*m_players)[conn.second];
+                std::string msg = "frame " + std::to_string(m_layout->frame) + " pid " + std::to_string(getpid())
+                                  + " pos " + std::to_string(p.x) + " " + std::to_string(p.y) + "\n";
+                send(conn.first, msg.c_str(), msg.size(), MSG_NOSIGNAL);
+            }
+        }
+    }
+
+    /// 新进程请求接管：在帧边界交出所有 socket，成功返回 true，调用者随即退出
+    bool hand_off() {
+        int ctrl = accept4(m_ctrlfd, NULL, NULL, SOCK_CLOEXEC);
+        if (ctrl < 0) {
+            return false;
+        }
+        /// 交接期间使用阻塞 IO，帧循环在此暂停
+        std::vector<int> fds;
+        std::vector<uint32_t> tags;
+        fds.push_back(m_listenfd);
+        tags.push_back(0);
+        for (const auto& conn : m_conns) {
+            fds.push_back(conn.first);
+            tags.push_back(conn.second);
+        }
+
+        hot_restart::TakeoverRequest req;
+        bool ok = false;
+        if (hot_restart::read_all(ctrl, &req, sizeof(req)) && req.magic == hot_restart::HR_MAGIC) {
+            if (req.layout_version != LAYOUT_VERSION) {
+                std::cout << "reject takeover: layout version " << req.layout_version
+                          << " != " << LAYOUT_VERSION << std::endl;
+                hot_restart::reject(ctrl);
+            } else {
+                ok = hot_restart::give_fds(ctrl, m_layout->frame, fds, tags);
+            }
+        }
+        close(ctrl);
+        if (!ok) {
+            std::cout << "takeover failed, keep running" << std::endl;
+            return false;
+        }
+        std::cout << "handed off at frame " << m_layout->frame << ", exiting" << std::endl;
+        /// 共享内存已归新进程所有，退出时不能改写其中的状态
+        m_arena->detach(false);
+        return true;
+    }
+
+    int m_epollfd;
+    int m_listenfd;
+    int m_ctrlfd;
+    std::unique_ptr<shm::Arena> m_arena;
+    GameLayout* m_layout;
+    PlayerPool* m_players;
+    std::unordered_map<int, uint32_t> m_conns;  /// 连接 fd -> 玩家槽位
+};
+
+int main(int argc, char const *argv[]) {
+    if (argc <= 1) {
+        std::cout << "usage : " << basename(argv[0]) << " port_number" << std::endl;
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    GameServer server;
+    int ctrl = hot_restart::connect_control(g_ctrl_path);
+    if (ctrl >= 0) {
+        bool ok = server.take_over(ctrl);
+        close(ctrl);
+        if (!ok) {
+            return 1;
+        }
+    } else if (!server.cold_start(atoi(argv[1]))) {
+        return 1;
+    }
+    server.run();
+    /// 交接后直接退出：客户连接已由新进程持有，共享内存保持不变
+    return 0;
+}
@@ -0,0 +1,436 @@
+#ifndef __SHM_ARENA_H__
+#define __SHM_ARENA_H__
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+
+/**
+ * 轻量级的进程间共享内存 arena
+ *
+ * managed_shared_memory 的 segment_manager 是通用分配器：每次分配都要加进程间锁并做 best-fit 查找，
+ * 对每帧都要分配的游戏状态来说太慢。这里换成更简单的结构：
+ *   - 整块共享内存由 ArenaHeader 描述，内部只用偏移量指针（OffsetPtr），任何进程映射到任何地址都能直接使用；
+ *   - 持久区：bump 分配，启动时创建实体池等长期对象，只增不减；
+ *   - 帧区：bump 分配，每帧 reset_frame() 一次性回收并推进 epoch；
+ *   - FixedPool<T>：定长实体池，O(1) 分配/释放，槽位带存活标记，进程崩溃后 restore 时可据此重建空闲链表。
+ * 共享内存对象在进程崩溃后依然存在，新进程 attach 后校验头部即可继续使用在线玩家状态，无需重新序列化。
+*/
+
+namespace shm {
+
+/// 自相对偏移指针：保存目标地址与自身地址之差，0 表示空指针
+template <class T>
+class OffsetPtr {
+public:
+    OffsetPtr() : m_off(0) {}
+    OffsetPtr(T* p) { set(p); }
+    OffsetPtr(const OffsetPtr& other) { set(other.get()); }
+    OffsetPtr& operator=(const OffsetPtr& other) { set(other.get()); return *this; }
+    OffsetPtr& operator=(T* p) { set(p); return *this; }
+
+    T* get() const {
+        return m_off == 0 ? nullptr
+                          : reinterpret_cast<T*>(reinterpret_cast<intptr_t>(this) + m_off);
+    }
+    T* operator->() const { return get(); }
+    typename std::add_lvalue_reference<T>::type operator*() const { return *get(); }
+    explicit operator bool() const { return m_off != 0; }
+
+private:
+    void set(T* p) {
+        m_off = p == nullptr ? 0 : reinterpret_cast<intptr_t>(p) - reinterpret_cast<intptr_t>(this);
+    }
+
+    intptr_t m_off;
+};
+
+static const uint64_t ARENA_MAGIC = 0x4152454e41474d53ULL;  /// "SMGANERA"
+static const uint32_t ARENA_VERSION = 1;
+static const uint32_t ARENA_MAX_ROOTS = 16;
+
+/// 位于共享内存起始处的头部，所有字段都与映射地址无关
+struct ArenaHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;               /// sizeof(ArenaHeader)，布局变化时校验失败
+    uint64_t total_size;
+    uint64_t frame_begin;               /// 帧区起始偏移，之前为持久区
+    std::atomic<uint64_t> persist_top;  /// 持久区的 bump 指针（偏移）
+    std::atomic<uint64_t> frame_top;    /// 帧区的 bump 指针（偏移）
+    std::atomic<uint64_t> epoch;        /// 帧区每 reset 一次加一
+    std::atomic<uint32_t> attach_count; /// 累计 attach 次数，便于观察重启
+    uint32_t clean_shutdown;            /// 正常 detach 时置 1，attach 时置 0
+    OffsetPtr<void> roots[ARENA_MAX_ROOTS]; /// 具名根对象，重启后据此找回数据
+    char root_names[ARENA_MAX_ROOTS][32];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "arena needs address-free 64-bit atomics");
+
+/// 帧区分配得到的句柄：记录分配时的 epoch，reset 之后再访问会被检测出来
+template <class T>
+struct FrameRef {
+    uint64_t offset;
+    uint64_t epoch;
+};
+
+class Arena {
+public:
+    /**
+     * 打开已有的共享内存；不存在时创建大小为 size、其中持久区为 persist_size 的新 arena
+     * 已存在但头部不匹配（版本或布局变化）时抛出异常，由调用者决定是否 remove 后重建
+    */
+    static Arena open_or_create(const char* name, uint64_t size, uint64_t persist_size) {
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+        if (fd >= 0) {
+            if (ftruncate(fd, size) == -1) {
+                close(fd);
+                shm_unlink(name);
+                throw std::runtime_error("ftruncate shm failed");
+            }
+            /// 初始化中途失败时删除这段共享内存，否则它会以无效的 magic 留在系统里，之后每次 attach 都被拒绝
+            try {
+                Arena arena(fd, size);
+                try {
+                    arena.format(size, persist_size);
+                } catch (...) {
+                    arena.detach(false);
+                    throw;
+                }
+                return arena;
+            } catch (...) {
+                shm_unlink(name);
+                throw;
+            }
+        }
+        if (errno != EEXIST) {
+            throw std::runtime_error(std::string("shm_open failed: ") + strerror(errno));
+        }
+        return attach(name);
+    }
+
+    /// 只 attach 已有的 arena，并校验头部
+    static Arena attach(const char* name) {
+        int fd = shm_open(name, O_RDWR, 0666);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("shm_open failed: ") + strerror(errno));
+        }
+        struct stat st;
+        if (fstat(fd, &st) == -1 || static_cast<uint64_t>(st.st_size) < sizeof(ArenaHeader)) {
+            close(fd);
+            throw std::runtime_error("shm segment too small");
+        }
+        Arena arena(fd, st.st_size);
+        try {
+            arena.validate();
+        } catch (...) {
+            /// 校验失败的 arena 不属于本进程，不能在析构时替它标记正常退出
+            arena.detach(false);
+            throw;
+        }
+        arena.m_restored = true;
+        return arena;
+    }
+
+    static void remove(const char* name) {
+        shm_unlink(name);
+    }
+
+    Arena(Arena&& other) noexcept
+        : m_base(other.m_base), m_size(other.m_size), m_restored(other.m_restored), m_last_clean(other.m_last_clean) {
+        other.m_base = nullptr;
+        other.m_size = 0;
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() {
+        detach(true);
+    }
+
+    /// 解除映射。clean 为 false 时不标记正常退出，用于把 arena 交给已经 attach 的新进程
+    void detach(bool clean) {
+        if (m_base != nullptr) {
+            if (clean) {
+                header()->clean_shutdown = 1;
+            }
+            munmap(m_base, m_size);
+            m_base = nullptr;
+        }
+    }
+
+    ArenaHeader* header() const { return reinterpret_cast<ArenaHeader*>(m_base); }
+    char* base() const { return m_base; }
+
+    /// 本次是否 attach 到了已有数据（重启恢复）
+    bool restored() const { return m_restored; }
+
+    /// 上一个使用者是否是正常退出的；为 false 说明发生过崩溃
+    bool last_shutdown_clean() const { return m_last_clean; }
+
+    /// 持久区分配，失败返回 nullptr
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        return bump(header()->persist_top, header()->frame_begin, size, align);
+    }
+
+    /// 在持久区构造对象
+    template <class T, class... Args>
+    T* construct(Args&&... args) {
+        void* p = allocate(sizeof(T), alignof(T));
+        return p == nullptr ? nullptr : new (p) T(std::forward<Args>(args)...);
+    }
+
+    /// 帧区分配：只在当前 epoch 内有效，失败返回 nullptr
+    void* allocate_frame(size_t size, size_t align = alignof(std::max_align_t)) {
+        return bump(header()->frame_top, header()->total_size, size, align);
+    }
+
+    template <class T>
+    T* allocate_frame_array(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "frame objects are never destroyed");
+        return static_cast<T*>(allocate_frame(sizeof(T) * n, alignof(T)));
+    }
+
+    template <class T>
+    FrameRef<T> frame_ref(T* p) const {
+        return FrameRef<T>{static_cast<uint64_t>(reinterpret_cast<char*>(p) - m_base), epoch()};
+    }
+
+    /// 解析帧区句柄；句柄来自已被 reset 的 epoch 时返回 nullptr
+    template <class T>
+    T* resolve(const FrameRef<T>& ref) const {
+        return ref.epoch == epoch() ? reinterpret_cast<T*>(m_base + ref.offset) : nullptr;
+    }
+
+    /// 回收整个帧区并推进 epoch，必须在没有其他线程分配帧区内存时调用
+    uint64_t reset_frame() {
+        header()->frame_top.store(header()->frame_begin, std::memory_order_relaxed);
+        return header()->epoch.fetch_add(1, std::memory_order_release) + 1;
+    }
+
+    uint64_t epoch() const {
+        return header()->epoch.load(std::memory_order_acquire);
+    }
+
+    uint64_t persist_used() const {
+        return header()->persist_top.load(std::memory_order_relaxed) - align_up(sizeof(ArenaHeader), 64);
+    }
+
+    uint64_t frame_used() const {
+        return header()->frame_top.load(std::memory_order_relaxed) - header()->frame_begin;
+    }
+
+    /// 登记具名根对象，返回 false 表示根表已满
+    bool set_root(const char* name, void* p) {
+        ArenaHeader* h = header();
+        for (uint32_t i = 0; i < ARENA_MAX_ROOTS; ++i) {
+            if (h->root_names[i][0] == '\0' || strcmp(h->root_names[i], name) == 0) {
+                strncpy(h->root_names[i], name, sizeof(h->root_names[i]) - 1);
+                h->roots[i] = p;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <class T>
+    T* find_root(const char* name) const {
+        ArenaHeader* h = header();
+        for (uint32_t i = 0; i < ARENA_MAX_ROOTS; ++i) {
+            if (strcmp(h->root_names[i], name) == 0) {
+                return static_cast<T*>(h->roots[i].get());
+            }
+        }
+        return nullptr;
+    }
+
+    /// 查找具名根对象，不存在时在持久区构造并登记
+    template <class T, class... Args>
+    T* find_or_construct(const char* name, Args&&... args) {
+        T* p = find_root<T>(name);
+        if (p == nullptr) {
+            p = construct<T>(std::forward<Args>(args)...);
+            if (p != nullptr && !set_root(name, p)) {
+                return nullptr;
+            }
+        }
+        return p;
+    }
+
+private:
+    Arena(int fd, uint64_t size) : m_base(nullptr), m_size(size), m_restored(false), m_last_clean(true) {
+        void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error(std::string("mmap shm failed: ") + strerror(errno));
+        }
+        m_base = static_cast<char*>(p);
+    }
+
+    void format(uint64_t size, uint64_t persist_size) {
+        if (persist_size + sizeof(ArenaHeader) > size) {
+            throw std::runtime_error("persist_size larger than arena");
+        }
+        ArenaHeader* h = new (m_base) ArenaHeader();
+        h->version = ARENA_VERSION;
+        h->header_size = sizeof(ArenaHeader);
+        h->total_size = size;
+        h->frame_begin = align_up(sizeof(ArenaHeader) + persist_size, 64);
+        h->persist_top.store(align_up(sizeof(ArenaHeader), 64));
+        h->frame_top.store(h->frame_begin);
+        h->epoch.store(1);
+        h->attach_count.store(1);
+        h->clean_shutdown = 0;
+        /// magic 最后写入：崩溃在初始化中途的 arena 会在 attach 时被拒绝
+        std::atomic_thread_fence(std::memory_order_release);
+        h->magic = ARENA_MAGIC;
+    }
+
+    void validate() {
+        ArenaHeader* h = header();
+        if (h->magic != ARENA_MAGIC) {
+            throw std::runtime_error("shm arena: bad magic");
+        }
+        if (h->version != ARENA_VERSION || h->header_size != sizeof(ArenaHeader)) {
+            throw std::runtime_error("shm arena: layout version mismatch");
+        }
+        if (h->total_size != m_size) {
+            throw std::runtime_error("shm arena: size mismatch");
+        }
+        m_last_clean = h->clean_shutdown != 0;
+        h->clean_shutdown = 0;
+        h->attach_count.fetch_add(1);
+    }
+
+    static uint64_t align_up(uint64_t n, uint64_t align) {
+        return (n + align - 1) & ~(align - 1);
+    }
+
+    void* bump(std::atomic<uint64_t>& top, uint64_t limit, size_t size, size_t align) {
+        uint64_t old_top = top.load(std::memory_order_relaxed);
+        for (;;) {
+            uint64_t begin = align_up(old_top, align);
+            uint64_t end = begin + size;
+            if (end > limit) {
+                return nullptr;
+            }
+            if (top.compare_exchange_weak(old_top, end, std::memory_order_relaxed)) {
+                return m_base + begin;
+            }
+        }
+    }
+
+    char* m_base;
+    uint64_t m_size;
+    bool m_restored;
+    bool m_last_clean;
+};
+
+/**
+ * 定长实体池，整体放在 arena 的持久区
+ * 只能由一个线程（帧线程）分配和释放；T 必须可平凡拷贝，保证可以原样跨进程存活
+*/
+template <class T, uint32_t N>
+class FixedPool {
+    static_assert(std::is_trivially_copyable<T>::value, "pool objects must survive as raw bytes");
+
+public:
+    static const uint32_t npos = 0xFFFFFFFFu;
+
+    FixedPool() {
+        clear();
+    }
+
+    /// 分配一个槽位，返回其下标；池满返回 npos
+    uint32_t alloc() {
+        uint32_t idx = m_free_head;
+        if (idx == npos) {
+            return npos;
+        }
+        m_free_head = m_next[idx];
+        m_next[idx] = npos;
+        new (&m_slots[idx]) T();
+        /// 先写好对象再标记存活，崩溃时最多泄漏一个槽，restore 会把它找回来
+        m_alive[idx] = 1;
+        ++m_size;
+        return idx;
+    }
+
+    void free(uint32_t idx) {
+        if (idx >= N || !m_alive[idx]) {
+            return;
+        }
+        m_alive[idx] = 0;
+        m_next[idx] = m_free_head;
+        m_free_head = idx;
+        --m_size;
+    }
+
+    T* get(uint32_t idx) {
+        return idx < N && m_alive[idx] ? &m_slots[idx] : nullptr;
+    }
+
+    T& operator[](uint32_t idx) { return m_slots[idx]; }
+
+    uint32_t size() const { return m_size; }
+    static constexpr uint32_t capacity() { return N; }
+
+    template <class F>
+    void for_each(F&& f) {
+        for (uint32_t i = 0; i < N; ++i) {
+            if (m_alive[i]) {
+                f(i, m_slots[i]);
+            }
+        }
+    }
+
+    /**
+     * 重启恢复：只信任每个槽的存活标记，重建空闲链表和计数
+     * 上一个进程如果崩溃在 alloc/free 中途，空闲链表可能不一致，这里会将其修复
+    */
+    void restore() {
+        m_free_head = npos;
+        m_size = 0;
+        for (uint32_t i = N; i-- > 0;) {
+            if (m_alive[i]) {
+                m_next[i] = npos;
+                ++m_size;
+            } else {
+                m_next[i] = m_free_head;
+                m_free_head = i;
+            }
+        }
+    }
+
+    void clear() {
+        for (uint32_t i = 0; i < N; ++i) {
+            m_alive[i] = 0;
+            m_next[i] = i + 1 < N ? i + 1 : npos;
+        }
+        m_free_head = N > 0 ? 0 : npos;
+        m_size = 0;
+    }
+
+private:
+    uint32_t m_free_head;
+    uint32_t m_size;
+    uint32_t m_next[N];
+    uint8_t m_alive[N];
+    alignas(64) T m_slots[N];
+};
+
+}  // namespace shm
+
+#endif
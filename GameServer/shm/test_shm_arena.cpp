@@ -0,0 +1,137 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <boost/interprocess/managed_shared_memory.hpp>
+
+#include "shm_arena.h"
+
+/**
+ * shm_arena.h 的演示：
+ *   ./test_shm_arena            第一次运行创建 arena 和玩家池；之后再运行会 attach 并恢复上次的玩家状态
+ *   ./test_shm_arena crash      模拟若干帧后 abort()，再次运行可以看到玩家状态完整保留
+ *   ./test_shm_arena bench      对比 arena bump 分配和 managed_shared_memory::allocate 的耗时
+ *   ./test_shm_arena remove     删除共享内存
+ * 编译: g++ -std=c++17 -O2 test_shm_arena.cpp -o tests/test_shm_arena -lrt
+*/
+
+struct Player {
+    int id;
+    float x;
+    float y;
+    int hp;
+};
+
+struct Event {
+    int player;
+    int type;
+};
+
+static const char* g_arena_name = "/GameArena";
+static const uint32_t MAX_PLAYERS = 1024;
+typedef shm::FixedPool<Player, MAX_PLAYERS> PlayerPool;
+
+/// 一帧：移动所有玩家，事件只在帧区分配，帧末整体回收
+void tick(shm::Arena& arena, PlayerPool* players) {
+    Event* events = arena.allocate_frame_array<Event>(players->size());
+    uint32_t n = 0;
+    players->for_each([&](uint32_t, Player& p) {
+        p.x += 1.0f;
+        p.y += 0.5f;
+        if (events != nullptr) {
+            events[n++] = Event{p.id, 1};
+        }
+    });
+    arena.reset_frame();
+}
+
+void run(bool crash) {
+    shm::Arena arena = shm::Arena::open_or_create(g_arena_name, 4 << 20, 1 << 20);
+    PlayerPool* players = arena.find_or_construct<PlayerPool>("players");
+    if (players == nullptr) {
+        std::cout << "arena out of memory" << std::endl;
+        return;
+    }
+
+    if (arena.restored()) {
+        /// 上一个进程可能崩溃在池操作中途，以存活标记为准修复空闲链表
+        players->restore();
+        std::cout << "attached, attach_count=" << arena.header()->attach_count
+                  << ", last shutdown " << (arena.last_shutdown_clean() ? "clean" : "crashed")
+                  << ", epoch=" << arena.epoch() << ", players=" << players->size() << std::endl;
+    } else {
+        for (int i = 0; i < 4; ++i) {
+            uint32_t idx = players->alloc();
+            (*players)[idx] = Player{i, 0.0f, 0.0f, 100};
+        }
+        std::cout << "created arena with " << players->size() << " players" << std::endl;
+    }
+
+    for (int frame = 0; frame < 10; ++frame) {
+        tick(arena, players);
+    }
+
+    players->for_each([](uint32_t, const Player& p) {
+        std::cout << "player " << p.id << " at (" << p.x << ", " << p.y << ")" << std::endl;
+    });
+    std::cout << "persist used " << arena.persist_used() << " bytes, epoch " << arena.epoch() << std::endl;
+
+    if (crash) {
+        std::cout << "simulate crash" << std::endl;
+        std::abort();
+    }
+}
+
+void bench() {
+    namespace bip = boost::interprocess;
+    const int N = 1000000;
+    typedef std::chrono::steady_clock clock;
+
+    shm::Arena::remove("/GameArenaBench");
+    {
+        shm::Arena arena = shm::Arena::open_or_create("/GameArenaBench", 64 << 20, 1 << 20);
+        auto start = clock::now();
+        for (int i = 0; i < N; ++i) {
+            if (arena.allocate_frame(32) == nullptr) {
+                arena.reset_frame();
+            }
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+        std::cout << "arena bump allocate: " << static_cast<double>(ns) / N << " ns/op" << std::endl;
+    }
+    shm::Arena::remove("/GameArenaBench");
+
+    bip::shared_memory_object::remove("GameArenaBenchBip");
+    {
+        bip::managed_shared_memory segment(bip::create_only, "GameArenaBenchBip", 64 << 20);
+        std::vector<void*> ptrs;
+        ptrs.reserve(N);
+        auto start = clock::now();
+        for (int i = 0; i < N; ++i) {
+            ptrs.push_back(segment.allocate(32));
+        }
+        for (void* p : ptrs) {
+            segment.deallocate(p);
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+        std::cout << "segment_manager allocate+deallocate: " << static_cast<double>(ns) / N << " ns/op" << std::endl;
+    }
+    bip::shared_memory_object::remove("GameArenaBenchBip");
+}
+
+int main(int argc, char const *argv[]) {
+    std::string cmd = argc > 1 ? argv[1] : "";
+    try {
+        if (cmd == "remove") {
+            shm::Arena::remove(g_arena_name);
+        } else if (cmd == "bench") {
+            bench();
+        } else {
+            run(cmd == "crash");
+        }
+    } catch (const std::exception& e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,13 +1,157 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <linux/filter.h>
+
+/*
+    UDP回声服务器
+    ./userver <port>                       单个套接字、单线程
+    ./userver <port> <threads> [bpf]       SO_REUSEPORT 多套接字模式：
+        创建 threads 个绑定到同一端口的UDP套接字，每个套接字由一个绑定到固定CPU的线程独占处理，
+        内核按四元组哈希把数据报分发到各个套接字，线程之间没有任何共享状态（各自的缓冲区、各自的计数器）。
+        加上 bpf 参数时，再给套接字组挂一个经典BPF程序，按处理该数据报的CPU编号选择套接字（cpu % threads），
+        配合网卡RSS队列的中断亲和性，数据报从软中断到用户态线程都留在同一个CPU上，不跨核传递缓存行。
+*/
 
 #define BUF_SIZE 30
+#define MAX_THREADS 64
+#define REPORT_INTERVAL 5   // 每隔几秒打印一次各线程处理的数据报数
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
 void error_handing(char* message);
 
+// 每个线程独占一个缓存行的计数器，避免伪共享
+struct worker
+{
+    int sock;
+    int cpu;
+    pthread_t tid;
+    volatile unsigned long packets;
+} __attribute__((aligned(64)));
+
+static struct worker workers[MAX_THREADS];
+
+int create_reuseport_socket(int port)
+{
+    int sock, option = 1;
+    struct sockaddr_in serv_adr;
+
+    sock = socket(PF_INET, SOCK_DGRAM, 0);
+    if (sock == -1)
+    {
+        error_handing("UDP socket create error");
+    }
+    // 所有套接字在 bind 之前都要设置 SO_REUSEPORT，且属于同一个有效用户
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option)) == -1)
+    {
+        error_handing("setsockopt(SO_REUSEPORT) error");
+    }
+
+    memset(&serv_adr, 0 , sizeof(serv_adr));
+    serv_adr.sin_family = AF_INET;
+    serv_adr.sin_addr.s_addr = htonl(INADDR_ANY);
+    serv_adr.sin_port = htons(port);
+    if (bind(sock, (struct sockaddr*)&serv_adr, sizeof(serv_adr)) == -1)
+    {
+        error_handing("bind() error");
+    }
+    return sock;
+}
+
+// 经典BPF：A = 当前CPU编号; A = A % n; 返回A作为组内套接字下标（超出范围时内核退回哈希分发）
+void attach_cpu_steering(int sock, int n)
+{
+    struct sock_filter code[] = {
+        { BPF_LD  | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (unsigned int)n },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog prog = { sizeof(code) / sizeof(code[0]), code };
+
+    // 程序挂在整个 reuseport 组上，对任意一个组内套接字设置一次即可
+    if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == -1)
+    {
+        error_handing("setsockopt(SO_ATTACH_REUSEPORT_CBPF) error");
+    }
+}
+
+void* worker_main(void* arg)
+{
+    struct worker* w = (struct worker*)arg;
+    char message[BUF_SIZE];
+    int str_len;
+    socklen_t clnt_adr_sz;
+    struct sockaddr_in clnt_adr;
+    cpu_set_t cpus;
+
+    CPU_ZERO(&cpus);
+    CPU_SET(w->cpu, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+    {
+        fprintf(stderr, "pin thread to cpu %d failed\n", w->cpu);
+    }
+
+    while (1)
+    {
+        clnt_adr_sz = sizeof(clnt_adr);
+        str_len = recvfrom(w->sock, message, BUF_SIZE, 0, (struct sockaddr*)&clnt_adr, &clnt_adr_sz);
+        if (str_len < 0)
+        {
+            continue;
+        }
+        sendto(w->sock, message, str_len, 0, (struct sockaddr*)&clnt_adr, clnt_adr_sz);
+        w->packets++;   // 只有本线程写
+    }
+    return NULL;
+}
+
+void run_reuseport(int port, int threads, int use_bpf)
+{
+    int i, ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (threads < 1 || threads > MAX_THREADS)
+    {
+        error_handing("thread count must be in [1, 64]");
+    }
+    for (i = 0; i < threads; i++)
+    {
+        workers[i].sock = create_reuseport_socket(port);
+        workers[i].cpu = i % ncpu;
+    }
+    // 必须在所有套接字都加入组之后挂载，组内下标按 bind 顺序分配，与 workers 下标一致
+    if (use_bpf)
+    {
+        attach_cpu_steering(workers[0].sock, threads);
+    }
+    for (i = 0; i < threads; i++)
+    {
+        if (pthread_create(&workers[i].tid, NULL, worker_main, &workers[i]) != 0)
+        {
+            error_handing("pthread_create() error");
+        }
+    }
+    printf("%d sockets on port %d, %s steering\n", threads, port, use_bpf ? "cpu (bpf)" : "hash");
+
+    while (1)
+    {
+        sleep(REPORT_INTERVAL);
+        for (i = 0; i < threads; i++)
+        {
+            printf("socket %d (cpu %d): %lu packets\n", i, workers[i].cpu, workers[i].packets);
+        }
+        fflush(stdout);
+    }
+}
+
 int main(int argc, char const *argv[])
 {
     int serv_sock;
@@ -15,13 +159,19 @@ int main(int argc, char const *argv[])
     int str_len;
     socklen_t clnt_adr_sz;
     struct sockaddr_in serv_adr, clnt_adr;
-    
-    if (argc != 2)
+
+    if (argc < 2 || argc > 4)
     {
-        printf("Usage : %s <port>\n", argv[0]);
+        printf("Usage : %s <port> [threads] [bpf]\n", argv[0]);
         exit(1);
     }
 
+    if (argc >= 3)
+    {
+        run_reuseport(atoi(argv[1]), atoi(argv[2]), argc == 4 && !strcmp(argv[3], "bpf"));
+        return 0;
+    }
+
     serv_sock = socket(PF_INET, SOCK_DGRAM, 0);  // 创建udp套接字
     if (serv_sock == -1)
     {
@@ -51,7 +201,7 @@ int main(int argc, char const *argv[])
         // 可选参数，存有目标地址信息的socketaddr结构体变量的地址，socketaddr 地址长度
         sendto(serv_sock, message, str_len, 0, (struct sockaddr*)&clnt_adr, clnt_adr_sz);
     }
-    
+
     close(serv_sock);
 
     return 0;
@@ -4,21 +4,166 @@
 #include <vector>
 #include <algorithm>
 #include <numeric>
+#include <future>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+#include "../ch9_高级线程管理/work_stealing_pool.h"
 
 using namespace std;
 
 using uL = unsigned long;
 
+/*
+    算术类型的求和内核
+    std::accumulate 每次加法都依赖上一次的结果，一条串行依赖链，每个时钟周期最多完成一次加法。
+    这里用 4 组相互独立的向量累加器（每组一个 SIMD 寄存器），循环每轮读 4 个寄存器宽度的数据，
+    加法延迟被 4 条独立的链掩盖，单线程就能接近 L1/L2 带宽，多线程时受内存带宽限制。
+    - 向量类型用 GCC 的 vector_size 扩展写一份通用代码，再分别以 target("avx2") / target("avx512f") 实例化，
+      不需要整个文件加 -mavx2 编译；第一次调用时用 CPUID（__builtin_cpu_supports，同时检查了操作系统是否保存 AVX 寄存器状态）
+      选出当前 CPU 支持的最宽版本，没有 AVX2 时退回标量的 4 路累加；
+    - 32/64 位整数统一按同宽度的无符号数相加，结果与 std::accumulate 一样按 2^N 取模；
+    - 浮点数改变了加法顺序，结果和 std::accumulate 可能在最后几位上不同（并行分块本来就有同样的问题）。
+*/
+
+template<typename U, int Bytes>
+inline __attribute__((always_inline)) U sum_vector(const U* p, size_t n)
+{
+    typedef U vec __attribute__((vector_size(Bytes)));
+    const size_t lanes = Bytes / sizeof(U);
+    vec a0 = {}, a1 = {}, a2 = {}, a3 = {};
+    size_t i = 0;
+    for (; i + 4 * lanes <= n; i += 4 * lanes)
+    {
+        vec v0, v1, v2, v3;
+        memcpy(&v0, p + i, sizeof(vec));  // 非对齐加载
+        memcpy(&v1, p + i + lanes, sizeof(vec));
+        memcpy(&v2, p + i + 2 * lanes, sizeof(vec));
+        memcpy(&v3, p + i + 3 * lanes, sizeof(vec));
+        a0 += v0;
+        a1 += v1;
+        a2 += v2;
+        a3 += v3;
+    }
+    a0 += a1 + a2 + a3;
+    U s = 0;
+    for (size_t k = 0; k < lanes; ++k)
+        s += a0[k];
+    for (; i < n; ++i)
+        s += p[i];
+    return s;
+}
+
+template<typename U>
+U sum_scalar(const U* p, size_t n)
+{
+    U s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        s0 += p[i];
+        s1 += p[i + 1];
+        s2 += p[i + 2];
+        s3 += p[i + 3];
+    }
+    for (; i < n; ++i)
+        s0 += p[i];
+    return s0 + s1 + s2 + s3;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template<typename U>
+__attribute__((target("avx2"))) U sum_avx2(const U* p, size_t n)
+{
+    return sum_vector<U, 32>(p, n);
+}
+
+template<typename U>
+__attribute__((target("avx512f"))) U sum_avx512(const U* p, size_t n)
+{
+    return sum_vector<U, 64>(p, n);
+}
+#endif
+
+template<typename U>
+struct sum_kernel
+{
+    typedef U (*fn)(const U*, size_t);
+    fn impl;
+    const char* name;
+
+    sum_kernel() : impl(sum_scalar<U>), name("scalar")
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            impl = sum_avx512<U>;
+            name = "avx512";
+        }
+        else if (__builtin_cpu_supports("avx2"))
+        {
+            impl = sum_avx2<U>;
+            name = "avx2";
+        }
+#endif
+    }
+
+    static const sum_kernel& get()
+    {
+        static const sum_kernel k;
+        return k;
+    }
+};
+
+// 元素类型 -> 内核使用的类型：32/64 位整数映射到同宽度的无符号数，float/double 不变，其余类型没有内核（void）
+template<typename T>
+struct sum_kernel_type
+{
+    typedef typename std::conditional<std::is_floating_point<T>::value && (sizeof(T) == 4 || sizeof(T) == 8), T,
+            typename std::conditional<std::is_integral<T>::value && !std::is_same<T, bool>::value && sizeof(T) == 8, uint64_t,
+            typename std::conditional<std::is_integral<T>::value && !std::is_same<T, bool>::value && sizeof(T) == 4, uint32_t,
+            void>::type>::type>::type type;
+};
+
+// 只有连续存储的迭代器（指针、vector 的迭代器）才能直接按数组求和
+template<typename Iterator, typename T>
+struct is_contiguous_iterator
+{
+    static const bool value = std::is_same<Iterator, T*>::value || std::is_same<Iterator, const T*>::value
+        || std::is_same<Iterator, typename std::vector<T>::iterator>::value
+        || std::is_same<Iterator, typename std::vector<T>::const_iterator>::value;
+};
+
 template<typename Iterator, typename T>
 struct accumulate_block
 {
-    void operator() (Iterator first, Iterator last, T& result)
+    typedef typename std::iterator_traits<Iterator>::value_type value_type;
+    typedef typename sum_kernel_type<value_type>::type kernel_type;
+
+    T operator() (Iterator first, Iterator last)
+    {
+        return sum(first, last, std::integral_constant<bool, std::is_same<value_type, T>::value
+            && !std::is_void<kernel_type>::value && is_contiguous_iterator<Iterator, T>::value>());
+    }
+
+private:
+    T sum(Iterator first, Iterator last, std::true_type)
     {
-        cout << "thread_id: " << std::this_thread::get_id() << endl;
-        result =  std::accumulate(first, last, result);  // 前闭后开区间, 不包含 last
+        const size_t n = last - first;
+        const kernel_type* p = reinterpret_cast<const kernel_type*>(&*first);
+        return static_cast<T>(sum_kernel<kernel_type>::get().impl(p, n));
+    }
+
+    T sum(Iterator first, Iterator last, std::false_type)
+    {
+        return std::accumulate(first, last, T());  // 前闭后开区间, 不包含 last
     }
 };
 
+// 各块作为任务提交到工作窃取线程池（../ch9_高级线程管理/work_stealing_pool.h），不再每次调用都创建、销毁线程；
+// 每块的结果通过 future 返回，主线程在等待期间也会帮忙执行池中的任务
 template<typename Iterator, typename T>
 T parallel_accumulate(Iterator first, Iterator last, T init)
 {
@@ -26,34 +171,42 @@ T parallel_accumulate(Iterator first, Iterator last, T init)
     if (!length)
         return init;
     
+    work_stealing_pool& pool = default_pool();
     const uL min_per_thread = 25;
     const uL max_threads = (length + min_per_thread - 1) / min_per_thread;  // 线程的最大数量 = 元素总量 / 每个线程处理元素的最低限定量
-    const uL hardware_threads = std::thread::hardware_concurrency();  // CPU 核心数量
-    const uL num_threads = std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
+    const uL num_threads = std::min<uL>(pool.size(), max_threads);  // 池中的工作线程数
 
     const uL block_size = length / num_threads;  // 总量分块，计算各线程需要分担的数量
     
-    std::vector<T> results(num_threads);  // 存放中间结果
-    std::vector<std::thread> threads(num_threads - 1);  // 主线程算一个
+    std::vector<std::future<T>> results(num_threads - 1);  // 存放中间结果
 
     Iterator block_start = first;
     for(uL i = 0; i < (num_threads - 1); ++i)
     {
         Iterator block_end = block_start;
         std::advance(block_end, block_size);  // 下一个开始，左闭右开
-        threads[i] = std::thread(accumulate_block<Iterator, T>(), 
-            block_start, block_end, std::ref(results[i]));  // 传入引用获取返回结果
+        results[i] = pool.submit([block_start, block_end]{
+            return accumulate_block<Iterator, T>()(block_start, block_end);
+        });
         block_start = block_end;
     }
 
-    accumulate_block<Iterator, T>()(block_start, last, results[num_threads - 1]);  // 发起所有线程后，主线程处理最后一块
+    T result = accumulate_block<Iterator, T>()(block_start, last);  // 提交所有任务后，主线程处理最后一块
 
-    for(auto& entry: threads)
+    for(auto& entry: results)
     {
-        entry.join();
+        result += pool.wait(entry);
     }
 
-    return std::accumulate(results.begin(), results.end(), init);
+    return init + result;
+}
+
+template<typename F>
+double time_ms(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
 void f()
@@ -66,13 +219,32 @@ void f()
         vec.push_back(i);
     }
 
-    auto res = parallel_accumulate<vector<uL>::iterator, uL>(vec.begin(), vec.end(), 0);
-    
+    const double mb = vec.size() * sizeof(uL) / 1e6;
+    uL res = 0;
+    // 打印吞吐量，并检查结果，避免被编译器当作无用计算优化掉
+    auto report = [&](const char* name, uL (*run)(const vector<uL>&)) {
+        double ms = time_ms([&]{ res = run(vec); });
+        cout << name << ": " << mb / ms << " GB/s" << (res == sum ? "" : " MISMATCH") << endl;
+    };
+    report("std::accumulate", [](const vector<uL>& v) { return std::accumulate(v.begin(), v.end(), uL(0)); });
+    report("4-way scalar", [](const vector<uL>& v) { return (uL)sum_scalar<uint64_t>(v.data(), v.size()); });
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+        report("avx2", [](const vector<uL>& v) { return (uL)sum_avx2<uint64_t>(v.data(), v.size()); });
+    if (__builtin_cpu_supports("avx512f"))
+        report("avx512", [](const vector<uL>& v) { return (uL)sum_avx512<uint64_t>(v.data(), v.size()); });
+#endif
+    cout << "parallel_accumulate uses the " << sum_kernel<uint64_t>::get().name << " kernel on "
+         << default_pool().size() << " threads" << endl;
+    report("parallel_accumulate", [](const vector<uL>& v) {
+        return parallel_accumulate<vector<uL>::const_iterator, uL>(v.begin(), v.end(), 0);
+    });
+
     cout << "res = " << res << endl;
     cout << "sum = " << sum << endl;
-    
-
 }
+
+// 编译: g++ -std=c++17 -O2 -pthread parallel_accumulate.cpp -o parallel_accumulate
 int main(int argc, char* argv[])
 {
     f();
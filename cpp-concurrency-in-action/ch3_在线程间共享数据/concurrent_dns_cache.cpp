@@ -0,0 +1,477 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+#include <time.h>
+
+using namespace std;
+
+/*
+    读多写少的并发缓存，替代 code_3_13.cpp 的 dns_cache（std::map + 一把 std::shared_mutex）
+
+    dns_cache 的每次读取都要对 shared_mutex 做一次原子加减，所有读线程争抢同一个缓存行；std::map 查找要沿着红黑树追指针。
+    这里：
+    - 按哈希值高位分成 64 个分片，每个分片是一张开放寻址的哈希表（线性探测，最多探测 PROBE_WINDOW 个槽），
+      键和值直接存放在槽里，一次查找只访问连续的几个槽；
+    - 每个槽自带一个 seqlock：写者把序号改成奇数、写入、再改回偶数；读者读序号、拷贝槽的内容、再读一次序号，
+      两次相同且为偶数则拷贝有效，否则重试。读路径上没有锁、没有原子读改写，只有普通的读，读吞吐随核数线性增长；
+      槽内的字段都是 relaxed 原子变量，读者和写者并发访问不算数据竞争；
+    - 写者按分片加互斥锁，互相之间只在同一分片上竞争；
+    - 每个条目带过期时间（TTL），过期的条目查找时视为不存在，由淘汰时顺带回收；
+    - 构造时给定内存上限，换算成每个分片的槽数（装载率不超过 1/2）。条目数到达上限时用 CLOCK 算法淘汰：
+      读者命中时置访问位（已置位时不再写，避免热点键的缓存行在读者之间来回传递），
+      分片的时钟指针扫过的条目访问位为 1 则清零放过，为 0 则淘汰；
+    - 删除只把槽标记为墓碑，不移动其他条目，读者不会因为条目搬动而漏查。
+    限制：键最长 KEY_MAX 字节，值必须是可平凡复制的类型；与写同一个键的写者并发时，读者可能得到一次未命中。
+*/
+
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// 毫秒级精度的单调时钟，比 steady_clock::now() 便宜，对以秒计的 TTL 足够
+inline uint64_t coarse_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+template<typename Value>
+class concurrent_cache
+{
+    static_assert(std::is_trivially_copyable<Value>::value, "cached values are copied word by word");
+
+private:
+    static const size_t KEY_MAX = 64;
+    static const size_t KEY_WORDS = KEY_MAX / 8;
+    static const size_t VALUE_WORDS = (sizeof(Value) + 7) / 8;
+    static const size_t PROBE_WINDOW = 16;
+    static const int SHARD_BITS = 6;
+    static const size_t SHARDS = 1 << SHARD_BITS;
+    static const uint64_t EMPTY = 0;        // 从未使用过的槽，查找到这里就可以停止
+    static const uint64_t TOMBSTONE = 1;    // 删除或淘汰后的槽，可以被插入复用，查找要越过它
+
+    struct alignas(64) slot
+    {
+        std::atomic<uint32_t> seq;
+        mutable std::atomic<uint8_t> referenced;    // CLOCK 访问位，不受 seqlock 保护
+        std::atomic<uint64_t> hash;
+        std::atomic<uint64_t> expire;
+        std::atomic<uint64_t> key[KEY_WORDS];
+        std::atomic<uint64_t> value[VALUE_WORDS];
+    };
+
+    struct alignas(64) shard
+    {
+        std::mutex write_mutex;
+        slot* slots;
+        size_t mask;
+        size_t live;        // 以下字段只在持有 write_mutex 时访问
+        size_t limit;
+        size_t hand;
+    };
+
+    shard shards[SHARDS];
+
+    static uint64_t hash_key(const uint64_t* kw)
+    {
+        uint64_t h = 0x9e3779b97f4a7c15ull;
+        for (size_t i = 0; i < KEY_WORDS; ++i)
+        {
+            h ^= kw[i];
+            h *= 0xbf58476d1ce4e5b9ull;
+            h ^= h >> 31;
+        }
+        return h < 2 ? h + 2 : h;   // 0 和 1 留给 EMPTY / TOMBSTONE
+    }
+
+    // 键按 8 字节一组打包，不足部分补 0
+    static bool pack_key(const std::string& key, uint64_t* kw)
+    {
+        if (key.size() > KEY_MAX)
+            return false;
+        memset(kw, 0, KEY_MAX);
+        memcpy(kw, key.data(), key.size());
+        return true;
+    }
+
+    shard& shard_of(uint64_t h) { return shards[h >> (64 - SHARD_BITS)]; }
+    const shard& shard_of(uint64_t h) const { return shards[h >> (64 - SHARD_BITS)]; }
+
+    static bool key_equals(const slot& sl, const uint64_t* kw)
+    {
+        for (size_t i = 0; i < KEY_WORDS; ++i)
+        {
+            if (sl.key[i].load(std::memory_order_relaxed) != kw[i])
+                return false;
+        }
+        return true;
+    }
+
+    // seqlock 写：序号为奇数期间读者会重试
+    static void write_slot(slot& sl, uint64_t h, const uint64_t* kw, const Value* v, uint64_t expire)
+    {
+        uint32_t s = sl.seq.load(std::memory_order_relaxed);
+        sl.seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        sl.hash.store(h, std::memory_order_relaxed);
+        sl.expire.store(expire, std::memory_order_relaxed);
+        if (kw)
+        {
+            for (size_t i = 0; i < KEY_WORDS; ++i)
+                sl.key[i].store(kw[i], std::memory_order_relaxed);
+        }
+        if (v)
+        {
+            uint64_t vw[VALUE_WORDS] = {};
+            memcpy(vw, v, sizeof(Value));
+            for (size_t i = 0; i < VALUE_WORDS; ++i)
+                sl.value[i].store(vw[i], std::memory_order_relaxed);
+        }
+        sl.seq.store(s + 2, std::memory_order_release);
+    }
+
+    static bool is_live(const slot& sl)
+    {
+        return sl.hash.load(std::memory_order_relaxed) > TOMBSTONE;
+    }
+
+    void remove_slot(shard& sh, slot& sl)
+    {
+        write_slot(sl, TOMBSTONE, nullptr, nullptr, 0);
+        --sh.live;
+    }
+
+    // CLOCK：时钟指针扫过存活的条目，过期的直接淘汰，访问位为 1 的清零放过，为 0 的淘汰
+    // 扫过两圈时所有访问位又都被读者置回了 1，就淘汰第二圈里遇到的第一个存活条目
+    void evict_one(shard& sh, uint64_t now)
+    {
+        for (size_t n = 0; n <= 2 * (sh.mask + 1); ++n)
+        {
+            slot& sl = sh.slots[sh.hand];
+            sh.hand = (sh.hand + 1) & sh.mask;
+            if (!is_live(sl))
+                continue;
+            if (n <= sh.mask && sl.expire.load(std::memory_order_relaxed) > now && sl.referenced.load(std::memory_order_relaxed))
+            {
+                sl.referenced.store(0, std::memory_order_relaxed);
+                continue;
+            }
+            remove_slot(sh, sl);
+            return;
+        }
+    }
+
+public:
+    // memory_budget 为槽数组占用的字节数上限
+    explicit concurrent_cache(size_t memory_budget)
+    {
+        size_t per_shard = memory_budget / sizeof(slot) / SHARDS;
+        size_t capacity = 64;
+        while (capacity * 2 <= per_shard)
+            capacity *= 2;
+        for (shard& sh : shards)
+        {
+            sh.slots = new slot[capacity];
+            for (size_t i = 0; i < capacity; ++i)
+            {
+                sh.slots[i].seq.store(0, std::memory_order_relaxed);
+                sh.slots[i].referenced.store(0, std::memory_order_relaxed);
+                sh.slots[i].hash.store(EMPTY, std::memory_order_relaxed);
+            }
+            sh.mask = capacity - 1;
+            sh.live = 0;
+            sh.limit = capacity / 2;
+            sh.hand = 0;
+        }
+    }
+
+    ~concurrent_cache()
+    {
+        for (shard& sh : shards)
+            delete[] sh.slots;
+    }
+
+    concurrent_cache(const concurrent_cache&) = delete;
+    concurrent_cache& operator=(const concurrent_cache&) = delete;
+
+    // 命中且未过期时拷贝到 out 并返回 true
+    bool find_entry(const std::string& key, Value& out) const
+    {
+        uint64_t kw[KEY_WORDS];
+        if (!pack_key(key, kw))
+            return false;
+        const uint64_t h = hash_key(kw);
+        const shard& sh = shard_of(h);
+        for (size_t i = 0; i < PROBE_WINDOW; ++i)
+        {
+            const slot& sl = sh.slots[(h + i) & sh.mask];
+            while (true)
+            {
+                uint32_t s1 = sl.seq.load(std::memory_order_acquire);
+                if (s1 & 1)
+                {
+                    cpu_relax();
+                    continue;
+                }
+                uint64_t sh_hash = sl.hash.load(std::memory_order_relaxed);
+                if (sh_hash == EMPTY)
+                    return false;
+                if (sh_hash != h)
+                    break;  // 哈希不同，不必校验，看下一个槽
+                bool same_key = key_equals(sl, kw);
+                uint64_t expire = sl.expire.load(std::memory_order_relaxed);
+                uint64_t vw[VALUE_WORDS];
+                for (size_t k = 0; k < VALUE_WORDS; ++k)
+                    vw[k] = sl.value[k].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sl.seq.load(std::memory_order_relaxed) != s1)
+                    continue;   // 读的过程中被改写了，重读这个槽
+                if (!same_key)
+                    break;
+                if (expire <= coarse_now_ns())
+                    return false;
+                if (!sl.referenced.load(std::memory_order_relaxed))
+                    sl.referenced.store(1, std::memory_order_relaxed);
+                memcpy(&out, vw, sizeof(Value));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 键过长时不缓存，返回 false
+    bool update_or_add_entry(const std::string& key, const Value& value, std::chrono::milliseconds ttl)
+    {
+        uint64_t kw[KEY_WORDS];
+        if (!pack_key(key, kw))
+            return false;
+        const uint64_t h = hash_key(kw);
+        shard& sh = shard_of(h);
+        const uint64_t now = coarse_now_ns();
+        const uint64_t expire = now + std::chrono::duration_cast<std::chrono::nanoseconds>(ttl).count();
+
+        std::lock_guard<std::mutex> lk(sh.write_mutex);
+        slot* free_slot = nullptr;
+        for (size_t i = 0; i < PROBE_WINDOW; ++i)
+        {
+            slot& sl = sh.slots[(h + i) & sh.mask];
+            uint64_t sh_hash = sl.hash.load(std::memory_order_relaxed);
+            if (sh_hash == h && key_equals(sl, kw))
+            {
+                write_slot(sl, h, nullptr, &value, expire);   // 已存在：只改值和过期时间
+                return true;
+            }
+            if (sh_hash == EMPTY)
+            {
+                if (!free_slot)
+                    free_slot = &sl;
+                break;
+            }
+            if (sh_hash == TOMBSTONE && !free_slot)
+                free_slot = &sl;
+        }
+
+        if (sh.live >= sh.limit)
+            evict_one(sh, now);
+        if (!free_slot)
+        {
+            // 探测窗口已满：在窗口内按同样的 CLOCK 规则选一个淘汰
+            for (size_t n = 0; n < 2 * PROBE_WINDOW && !free_slot; ++n)
+            {
+                slot& sl = sh.slots[(h + n % PROBE_WINDOW) & sh.mask];
+                if (!is_live(sl))
+                {
+                    free_slot = &sl;
+                }
+                else if (sl.expire.load(std::memory_order_relaxed) > now && sl.referenced.load(std::memory_order_relaxed))
+                {
+                    sl.referenced.store(0, std::memory_order_relaxed);
+                }
+                else
+                {
+                    remove_slot(sh, sl);
+                    free_slot = &sl;
+                }
+            }
+            // 读者不持锁地重新置位 referenced，两轮之间整个窗口都可能又被访问过：直接淘汰窗口里的第一个
+            if (!free_slot)
+            {
+                slot& sl = sh.slots[h & sh.mask];
+                if (is_live(sl))
+                    remove_slot(sh, sl);
+                free_slot = &sl;
+            }
+        }
+        free_slot->referenced.store(0, std::memory_order_relaxed);
+        write_slot(*free_slot, h, kw, &value, expire);
+        ++sh.live;
+        return true;
+    }
+
+    void erase(const std::string& key)
+    {
+        uint64_t kw[KEY_WORDS];
+        if (!pack_key(key, kw))
+            return;
+        const uint64_t h = hash_key(kw);
+        shard& sh = shard_of(h);
+        std::lock_guard<std::mutex> lk(sh.write_mutex);
+        for (size_t i = 0; i < PROBE_WINDOW; ++i)
+        {
+            slot& sl = sh.slots[(h + i) & sh.mask];
+            uint64_t sh_hash = sl.hash.load(std::memory_order_relaxed);
+            if (sh_hash == EMPTY)
+                return;
+            if (sh_hash == h && key_equals(sl, kw))
+            {
+                remove_slot(sh, sl);
+                return;
+            }
+        }
+    }
+
+    size_t size()
+    {
+        size_t n = 0;
+        for (shard& sh : shards)
+        {
+            std::lock_guard<std::mutex> lk(sh.write_mutex);
+            n += sh.live;
+        }
+        return n;
+    }
+
+    size_t capacity() const
+    {
+        return SHARDS * shards[0].limit;
+    }
+};
+
+// ---------------------------------------------------------------- 对照组与基准
+
+struct dns_entry
+{
+    uint32_t addrs[4];
+    uint32_t count;
+};
+
+// code_3_13.cpp 的写法
+class dns_cache
+{
+    std::map<std::string, dns_entry> entries;
+    mutable std::shared_mutex entry_mutex;
+
+public:
+    bool find_entry(const std::string& domain, dns_entry& out) const
+    {
+        std::shared_lock<std::shared_mutex> lk(entry_mutex);
+        auto it = entries.find(domain);
+        if (it == entries.end())
+            return false;
+        out = it->second;
+        return true;
+    }
+    bool update_or_add_entry(const std::string& domain, const dns_entry& dns_details, std::chrono::milliseconds)
+    {
+        std::lock_guard<std::shared_mutex> lk(entry_mutex);
+        entries[domain] = dns_details;
+        return true;
+    }
+};
+
+const int DOMAINS = 1 << 16;
+const int OPS_PER_THREAD = 1000000;
+const int WRITE_EVERY = 100;    // 每 100 次操作有一次更新
+
+// 每个线程随机查找，1% 为更新；返回每秒百万次操作
+template<typename Cache>
+double bench(Cache& cache, const std::vector<std::string>& domains, int threads)
+{
+    std::atomic<long> hits(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> ts;
+    for (int t = 0; t < threads; ++t)
+    {
+        ts.emplace_back([&cache, &domains, &hits, t]{
+            uint32_t x = 2463534242u + t * 7919;
+            long local_hits = 0;
+            dns_entry e;
+            for (int i = 0; i < OPS_PER_THREAD; ++i)
+            {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                const std::string& d = domains[x & (DOMAINS - 1)];
+                if (i % WRITE_EVERY == 0)
+                {
+                    e = dns_entry{{x, 0, 0, 0}, 1};
+                    cache.update_or_add_entry(d, e, std::chrono::seconds(300));
+                }
+                else if (cache.find_entry(d, e))
+                {
+                    ++local_hits;
+                }
+            }
+            hits += local_hits;
+        });
+    }
+    for (auto& t : ts)
+        t.join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return threads * OPS_PER_THREAD / sec / 1e6;
+}
+
+void f()
+{
+    // 过期与淘汰
+    concurrent_cache<dns_entry> small(64 * 1024 * 64);
+    dns_entry e = {{0x7f000001, 0, 0, 0}, 1};
+    small.update_or_add_entry("expired.example.com", e, std::chrono::milliseconds(0));
+    cout << "expired entry found: " << small.find_entry("expired.example.com", e) << endl;
+    small.update_or_add_entry("hot.example.com", e, std::chrono::seconds(60));
+    for (int i = 0; i < 100000; ++i)
+    {
+        small.update_or_add_entry("host" + std::to_string(i) + ".example.com", e, std::chrono::seconds(60));
+        small.find_entry("hot.example.com", e);
+    }
+    cout << "capacity " << small.capacity() << ", size after 100000 inserts " << small.size()
+         << ", hot entry kept: " << small.find_entry("hot.example.com", e) << endl;
+}
+
+// 编译: g++ -std=c++17 -O2 -pthread concurrent_dns_cache.cpp -o concurrent_dns_cache
+int main(int argc, char* argv[])
+{
+    f();
+
+    std::vector<std::string> domains;
+    for (int i = 0; i < DOMAINS; ++i)
+        domains.push_back("host" + std::to_string(i) + ".example.com");
+    dns_cache locked;
+    concurrent_cache<dns_entry> sharded(64 << 20);
+    for (int i = 0; i < DOMAINS; ++i)
+    {
+        dns_entry e = {{(uint32_t)i, 0, 0, 0}, 1};
+        locked.update_or_add_entry(domains[i], e, std::chrono::seconds(300));
+        sharded.update_or_add_entry(domains[i], e, std::chrono::seconds(300));
+    }
+
+    cout << "threads  map+shared_mutex(Mops/s)  sharded seqlock(Mops/s)" << endl;
+    for (int n = 1; n <= 64; n *= 2)
+        cout << n << "\t " << bench(locked, domains, n) << "\t\t\t   " << bench(sharded, domains, n) << endl;
+    cout << "Main thread..." << endl;
+    return 0;
+}
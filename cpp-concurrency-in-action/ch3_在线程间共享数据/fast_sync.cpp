@@ -0,0 +1,212 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+#include "fast_sync.h"
+
+using namespace std;
+
+/*
+    fast_sync.h 与标准库原语的对比，1 ~ 64 线程
+    1. 互斥：每个线程反复加锁、做一小段临界区工作、解锁，std::mutex 对比 adaptive_mutex；
+    2. 延迟初始化的热路径（初始化早已完成，只测访问）：
+        每次加锁（code_3_11.cpp 的第一种写法）、std::call_once（code_3_12.cpp）、
+        atomic 指针的双重检查锁定（singleton.cpp 的 LazySingleton 改用 acquire/release）、
+        函数内静态变量（MeyersLazySingleton）、fast_call_once、lazy<T>。
+*/
+
+const int LOCK_OPS = 200000;
+const int ACCESS_OPS = 2000000;
+
+// 构造函数不是 constexpr，静态变量需要运行时初始化（带 guard 检查）
+struct some_resource
+{
+    long value;
+    some_resource() : value(std::chrono::steady_clock::now().time_since_epoch().count() > 0) {}
+};
+
+template<typename Mutex>
+double bench_mutex(int threads)
+{
+    Mutex m;
+    long counter = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> ts;
+    for (int t = 0; t < threads; ++t)
+    {
+        ts.emplace_back([&]{
+            for (int i = 0; i < LOCK_OPS; ++i)
+            {
+                std::lock_guard<Mutex> lk(m);
+                counter += i & 7;
+            }
+        });
+    }
+    for (auto& t : ts)
+        t.join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long expected = 0;
+    for (int i = 0; i < LOCK_OPS; ++i)
+        expected += i & 7;
+    if (counter != expected * threads)
+        cout << "counter mismatch!" << endl;
+    return threads * LOCK_OPS / sec / 1e6;
+}
+
+// 各种延迟初始化写法，access() 返回初始化好的资源；都不参与过程间优化，避免编译器把检查提到循环外面
+struct locked_every_time
+{
+    std::mutex m;
+    std::unique_ptr<some_resource> p;
+    __attribute__((noipa)) some_resource& access()
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (!p)
+            p.reset(new some_resource);
+        return *p;
+    }
+};
+
+struct std_call_once
+{
+    std::once_flag flag;
+    std::unique_ptr<some_resource> p;
+    __attribute__((noipa)) some_resource& access()
+    {
+        std::call_once(flag, [this]{ p.reset(new some_resource); });
+        return *p;
+    }
+};
+
+struct atomic_dclp
+{
+    std::mutex m;
+    std::atomic<some_resource*> p{nullptr};
+    ~atomic_dclp() { delete p.load(); }
+    __attribute__((noipa)) some_resource& access()
+    {
+        some_resource* r = p.load(std::memory_order_acquire);
+        if (!r)
+        {
+            std::lock_guard<std::mutex> lk(m);
+            r = p.load(std::memory_order_relaxed);
+            if (!r)
+            {
+                r = new some_resource;
+                p.store(r, std::memory_order_release);
+            }
+        }
+        return *r;
+    }
+};
+
+struct meyers_static
+{
+    __attribute__((noipa)) some_resource& access()
+    {
+        static some_resource r;
+        return r;
+    }
+};
+
+struct fast_once
+{
+    fast_once_flag flag;
+    std::unique_ptr<some_resource> p;
+    __attribute__((noipa)) some_resource& access()
+    {
+        fast_call_once(flag, [this]{ p.reset(new some_resource); });
+        return *p;
+    }
+};
+
+struct lazy_value
+{
+    lazy<some_resource> r;
+    __attribute__((noipa)) some_resource& access() { return r.get(); }
+};
+
+template<typename Lazy>
+double bench_access(int threads)
+{
+    Lazy lz;
+    std::atomic<long> total(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> ts;
+    for (int t = 0; t < threads; ++t)
+    {
+        ts.emplace_back([&]{
+            long sum = 0;
+            for (int i = 0; i < ACCESS_OPS; ++i)
+                sum += lz.access().value;
+            total += sum;
+        });
+    }
+    for (auto& t : ts)
+        t.join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (total != (long)threads * ACCESS_OPS)
+        cout << "access mismatch!" << endl;
+    return threads * ACCESS_OPS / sec / 1e6;
+}
+
+// 多个线程同时第一次调用时初始化函数只执行一次；初始化抛异常后下一次调用重试
+void f()
+{
+    fast_once_flag flag;
+    std::atomic<int> runs(0);
+    std::vector<std::thread> ts;
+    for (int t = 0; t < 16; ++t)
+    {
+        ts.emplace_back([&]{
+            fast_call_once(flag, [&]{
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                ++runs;
+            });
+        });
+    }
+    for (auto& t : ts)
+        t.join();
+    cout << "init ran " << runs << " time(s)" << endl;
+
+    fast_once_flag retry;
+    try
+    {
+        fast_call_once(retry, []{ throw std::runtime_error("first attempt fails"); });
+    }
+    catch (const std::exception& e)
+    {
+        cout << "caught: " << e.what() << endl;
+    }
+    fast_call_once(retry, []{ cout << "second attempt runs" << endl; });
+    fast_call_once(retry, []{ cout << "never printed" << endl; });
+}
+
+// 编译: g++ -std=c++17 -O2 -pthread fast_sync.cpp -o fast_sync
+int main(int argc, char* argv[])
+{
+    f();
+
+    cout << "lock/unlock (Mops/s)" << endl << "threads  std::mutex  adaptive_mutex" << endl;
+    for (int n = 1; n <= 64; n *= 2)
+        cout << n << "\t " << bench_mutex<std::mutex>(n) << "\t     " << bench_mutex<adaptive_mutex>(n) << endl;
+
+    cout << "lazy-init hot path (Maccess/s)" << endl
+         << "threads  lock-always  std::call_once  atomic-DCLP  static-local  fast_call_once  lazy<T>" << endl;
+    for (int n = 1; n <= 64; n *= 2)
+    {
+        cout << n << "\t " << bench_access<locked_every_time>(n)
+             << "\t\t" << bench_access<std_call_once>(n)
+             << "\t\t" << bench_access<atomic_dclp>(n)
+             << "\t" << bench_access<meyers_static>(n)
+             << "\t\t" << bench_access<fast_once>(n)
+             << "\t\t" << bench_access<lazy_value>(n) << endl;
+    }
+    cout << "Main thread..." << endl;
+    return 0;
+}
@@ -0,0 +1,365 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stack>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <functional>
+
+using namespace std;
+
+/*
+    无锁栈（Treiber 栈）+ 风险指针（hazard pointer）内存回收，作为 threadsafe_stack 的替代
+
+    threadsafe_stack::pop() 在锁内 make_shared 拷贝栈顶，栈空时抛 empty_stack，异常成了常规控制流。
+    这里：
+    - push/pop 都是对 head 的一次 CAS，没有锁；try_pop(T&) 栈空时返回 false，不抛异常、不分配内存；
+    - pop 在读 head->next 之前先把 head 登记为自己的风险指针，其他线程 pop 掉这个节点后不会立刻删除，
+      而是放进本线程的待回收列表，攒够一批后扫描所有风险指针，只删除没有任何线程正在访问的节点。
+      被登记的节点不会被释放、也就不会被重新分配，CAS 因此不会遇到 ABA 问题；
+    - 可选的消除退避（elimination backoff）：CAS 失败说明竞争激烈，此时 push 把节点放到消除数组的某个槽里等一小会儿，
+      同时来 pop 的线程直接从槽里拿走，这一对操作完全不经过 head。
+*/
+
+// ---------------------------------------------------------------- 风险指针
+
+const int MAX_HAZARD_POINTERS = 128;    // 同时使用无锁栈的线程数上限
+
+struct hazard_pointer
+{
+    std::atomic<std::thread::id> id;
+    std::atomic<void*> pointer;
+    char pad[64 - sizeof(std::atomic<std::thread::id>) - sizeof(std::atomic<void*>)];  // 每个槽独占缓存行
+};
+hazard_pointer hazard_pointers[MAX_HAZARD_POINTERS];
+
+// 线程第一次使用时认领一个槽，线程退出时归还
+class hp_owner
+{
+    hazard_pointer* hp;
+
+public:
+    hp_owner() : hp(nullptr)
+    {
+        for (int i = 0; i < MAX_HAZARD_POINTERS; ++i)
+        {
+            std::thread::id old_id;
+            if (hazard_pointers[i].id.compare_exchange_strong(old_id, std::this_thread::get_id()))
+            {
+                hp = &hazard_pointers[i];
+                break;
+            }
+        }
+        if (!hp)
+            throw std::runtime_error("No hazard pointers available");
+    }
+    std::atomic<void*>& get_pointer() { return hp->pointer; }
+    ~hp_owner()
+    {
+        hp->pointer.store(nullptr);
+        hp->id.store(std::thread::id());
+    }
+};
+
+std::atomic<void*>& get_hazard_pointer_for_current_thread()
+{
+    thread_local static hp_owner hazard;
+    return hazard.get_pointer();
+}
+
+// 待回收的节点：类型擦除后的指针和删除函数
+struct retired_node
+{
+    void* p;
+    void (*deleter)(void*);
+};
+
+template<typename T>
+void delete_as(void* p)
+{
+    delete static_cast<T*>(p);
+}
+
+// 退出的线程留下的待回收节点，由其他线程扫描时顺带处理
+std::mutex orphan_mutex;
+std::vector<retired_node> orphan_nodes;
+
+class retire_list
+{
+    std::vector<retired_node> nodes;
+
+public:
+    void add(retired_node r)
+    {
+        nodes.push_back(r);
+        if (nodes.size() >= 2 * MAX_HAZARD_POINTERS)  // 攒够一批再扫描，均摊后每次回收的代价是 O(1)
+            scan();
+    }
+
+    void scan()
+    {
+        {
+            std::lock_guard<std::mutex> lk(orphan_mutex);
+            nodes.insert(nodes.end(), orphan_nodes.begin(), orphan_nodes.end());
+            orphan_nodes.clear();
+        }
+        std::vector<void*> hazards;
+        for (int i = 0; i < MAX_HAZARD_POINTERS; ++i)
+        {
+            void* p = hazard_pointers[i].pointer.load();
+            if (p)
+                hazards.push_back(p);
+        }
+        std::sort(hazards.begin(), hazards.end());
+        auto keep = std::partition(nodes.begin(), nodes.end(), [&](const retired_node& r) {
+            return std::binary_search(hazards.begin(), hazards.end(), r.p);
+        });
+        for (auto it = keep; it != nodes.end(); ++it)
+            it->deleter(it->p);
+        nodes.erase(keep, nodes.end());
+    }
+
+    ~retire_list()
+    {
+        scan();
+        std::lock_guard<std::mutex> lk(orphan_mutex);
+        orphan_nodes.insert(orphan_nodes.end(), nodes.begin(), nodes.end());
+    }
+};
+
+template<typename T>
+void retire(T* p)
+{
+    thread_local static retire_list list;
+    list.add(retired_node{p, delete_as<T>});
+}
+
+// ---------------------------------------------------------------- 无锁栈
+
+template<typename T, bool Elimination = false>
+class lock_free_stack
+{
+private:
+    struct node
+    {
+        T data;
+        node* next;
+        explicit node(T&& d) : data(std::move(d)), next(nullptr) {}
+    };
+
+    static const int ELIMINATION_SLOTS = 16;
+    static const int ELIMINATION_SPINS = 64;
+
+    alignas(64) std::atomic<node*> head;
+    // 消除数组：nullptr 表示空槽，TAKEN 表示节点已被 pop 取走
+    alignas(64) std::atomic<node*> slots[ELIMINATION_SLOTS];
+
+    static node* taken() { return reinterpret_cast<node*>(1); }
+
+    static int random_slot()
+    {
+        thread_local static std::minstd_rand rng(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        return rng() % ELIMINATION_SLOTS;
+    }
+
+    // push 一方：把节点放进槽里等待 pop 来取，返回 true 表示已被取走（push 完成）
+    bool try_eliminate_push(node* n)
+    {
+        std::atomic<node*>& slot = slots[random_slot()];
+        node* expected = nullptr;
+        if (!slot.compare_exchange_strong(expected, n))
+            return false;
+        for (int i = 0; i < ELIMINATION_SPINS; ++i)
+        {
+            if (slot.load(std::memory_order_acquire) == taken())
+            {
+                slot.store(nullptr, std::memory_order_release);
+                return true;
+            }
+        }
+        expected = n;
+        if (slot.compare_exchange_strong(expected, nullptr))
+            return false;   // 没人来取，撤回节点，回到 head 上重试
+        slot.store(nullptr, std::memory_order_release);  // 撤回前一刻被取走了
+        return true;
+    }
+
+    // pop 一方：从槽里取一个正在等待的 push 节点。节点从未进入过栈，取到后归本线程独有，可直接删除
+    bool try_eliminate_pop(T& value)
+    {
+        std::atomic<node*>& slot = slots[random_slot()];
+        node* n = slot.load(std::memory_order_acquire);
+        if (n == nullptr || n == taken() || !slot.compare_exchange_strong(n, taken()))
+            return false;
+        value = std::move(n->data);
+        delete n;
+        return true;
+    }
+
+public:
+    lock_free_stack() : head(nullptr)
+    {
+        for (auto& s : slots)
+            s.store(nullptr);
+    }
+
+    lock_free_stack(const lock_free_stack&) = delete;
+    lock_free_stack& operator=(const lock_free_stack&) = delete;
+
+    ~lock_free_stack()
+    {
+        node* n = head.load();
+        while (n)
+        {
+            node* next = n->next;
+            delete n;
+            n = next;
+        }
+    }
+
+    void push(T data)
+    {
+        node* const new_node = new node(std::move(data));
+        new_node->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(new_node->next, new_node, std::memory_order_release, std::memory_order_relaxed))
+        {
+            if (Elimination && try_eliminate_push(new_node))
+                return;
+        }
+    }
+
+    // 栈空时返回 false
+    bool try_pop(T& value)
+    {
+        std::atomic<void*>& hp = get_hazard_pointer_for_current_thread();
+        node* old_head = head.load();
+        while (true)
+        {
+            // 登记风险指针后必须重新确认 head 没变，否则登记的可能是一个已被回收的节点
+            node* temp;
+            do
+            {
+                temp = old_head;
+                hp.store(old_head);
+                old_head = head.load();
+            } while (old_head != temp);
+
+            if (!old_head)
+                break;
+            if (head.compare_exchange_strong(old_head, old_head->next))
+                break;
+            if (Elimination && try_eliminate_pop(value))
+            {
+                hp.store(nullptr);
+                return true;
+            }
+        }
+        hp.store(nullptr);
+        if (!old_head)
+            return false;
+        value = std::move(old_head->data);
+        retire(old_head);   // 其他线程可能还在读 old_head->next，延迟删除
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head.load() == nullptr;
+    }
+};
+
+// ---------------------------------------------------------------- 对照组与基准
+
+// threadsafe_stack 的非抛异常版本：一把锁保护 std::stack
+template<typename T>
+class locked_stack
+{
+    std::stack<T> data;
+    std::mutex m;
+
+public:
+    void push(T new_value)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        data.push(std::move(new_value));
+    }
+    bool try_pop(T& value)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        if (data.empty())
+            return false;
+        value = std::move(data.top());
+        data.pop();
+        return true;
+    }
+};
+
+const int OPS_PER_THREAD = 200000;
+
+// 每个线程交替 push 和 try_pop，返回每秒操作数（百万），并校验推入和取出的总和一致
+template<typename Stack>
+double bench(int threads)
+{
+    Stack st;
+    std::atomic<long long> pushed(0), popped(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> ts;
+    for (int t = 0; t < threads; ++t)
+    {
+        ts.emplace_back([&st, &pushed, &popped, t]{
+            long long in = 0, out = 0;
+            int v;
+            for (int i = 0; i < OPS_PER_THREAD; ++i)
+            {
+                int value = t * OPS_PER_THREAD + i;
+                st.push(value);
+                in += value;
+                if (st.try_pop(v))
+                    out += v;
+            }
+            pushed += in;
+            popped += out;
+        });
+    }
+    for (auto& t : ts)
+        t.join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    int v;
+    long long rest = 0;
+    while (st.try_pop(v))
+        rest += v;
+    if (pushed != popped + rest)
+        cout << "checksum mismatch!" << endl;
+    return 2.0 * threads * OPS_PER_THREAD / sec / 1e6;
+}
+
+void f()
+{
+    lock_free_stack<std::string> st;
+    st.push("a");
+    st.push("b");
+    std::string s;
+    while (st.try_pop(s))
+        cout << "pop:" << s << endl;
+    cout << "try_pop on empty: " << st.try_pop(s) << endl;
+}
+
+// 编译: g++ -std=c++17 -O2 -pthread lock_free_stack.cpp -o lock_free_stack
+int main(int argc, char* argv[])
+{
+    f();
+    cout << "threads  mutex(Mops/s)  lock-free(Mops/s)  lock-free+elimination(Mops/s)" << endl;
+    for (int n = 1; n <= 64; n *= 2)
+    {
+        cout << n << "\t " << bench<locked_stack<int>>(n)
+             << "\t\t" << bench<lock_free_stack<int>>(n)
+             << "\t\t   " << bench<lock_free_stack<int, true>>(n) << endl;
+    }
+    cout << "Main thread..." << endl;
+    return 0;
+}
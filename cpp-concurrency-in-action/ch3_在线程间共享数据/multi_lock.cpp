@@ -0,0 +1,192 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <random>
+#include <utility>
+
+#include "multi_lock.h"
+
+using namespace std;
+
+/*
+    multi_lock.h 的演示与对比
+    1. code_3_6.cpp 的 swap 改用 multi_lock，自己和自己交换也不会重复加锁；
+    2. 游戏交易：ACCOUNTS 个玩家账户各带一把锁，每笔交易随机挑 K 个不同的玩家，全部锁住后轮转一部分金币，
+       总金币数应保持不变。K = 2 ~ 16，比较 std::lock（需要编译期参数个数，这里按 K 展开）与 multi_lock 的吞吐。
+*/
+
+class some_big_object
+{
+public:
+    int data;
+    some_big_object(int d) : data(d) {}
+};
+
+void swap(some_big_object& lhs, some_big_object& rhs)
+{
+    std::swap(lhs.data, rhs.data);
+}
+
+class X
+{
+private:
+    some_big_object some_detail;
+    mutable std::mutex m;
+public:
+    X(const some_big_object& sd) : some_detail(sd) {}
+
+    friend void swap(X& lhs, X& rhs)
+    {
+        multi_lock<std::mutex> lk{&lhs.m, &rhs.m};     // lhs 与 rhs 相同时只锁一次
+        swap(lhs.some_detail, rhs.some_detail);
+    }
+
+    int value() const
+    {
+        std::lock_guard<std::mutex> lk(m);
+        return some_detail.data;
+    }
+};
+
+const int ACCOUNTS = 64;
+const int THREADS = 8;
+const int TRADES_PER_THREAD = 100000;
+const long INITIAL_GOLD = 1000;
+
+struct alignas(64) account
+{
+    std::mutex m;
+    long gold = INITIAL_GOLD;
+};
+
+// 从 ACCOUNTS 个账户中随机选 K 个不同的
+template<size_t K>
+std::array<int, K> pick_players(std::mt19937& rng)
+{
+    std::array<int, K> ids;
+    for (size_t i = 0; i < K; ++i)
+    {
+        bool dup;
+        do
+        {
+            ids[i] = rng() % ACCOUNTS;
+            dup = false;
+            for (size_t j = 0; j < i; ++j)
+                dup |= ids[j] == ids[i];
+        } while (dup);
+    }
+    return ids;
+}
+
+// 交易本身：每个玩家把 1/8 的金币交给下一个玩家
+template<size_t K>
+void trade(account* accounts, const std::array<int, K>& ids)
+{
+    long first = accounts[ids[0]].gold / 8;
+    for (size_t i = 0; i + 1 < K; ++i)
+    {
+        long give = accounts[ids[i + 1]].gold / 8;
+        accounts[ids[i]].gold += give;
+        accounts[ids[i + 1]].gold -= give;
+    }
+    accounts[ids[K - 1]].gold += first;
+    accounts[ids[0]].gold -= first;
+}
+
+template<size_t K, size_t... I>
+void lock_with_std_lock(account* accounts, const std::array<int, K>& ids, std::index_sequence<I...>)
+{
+    std::lock(accounts[ids[I]].m...);
+    trade(accounts, ids);
+    (accounts[ids[I]].m.unlock(), ...);
+}
+
+struct use_std_lock
+{
+    template<size_t K>
+    static void run(account* accounts, const std::array<int, K>& ids)
+    {
+        lock_with_std_lock(accounts, ids, std::make_index_sequence<K>());
+    }
+};
+
+struct use_multi_lock
+{
+    template<size_t K>
+    static void run(account* accounts, const std::array<int, K>& ids)
+    {
+        std::array<std::mutex*, K> ms;
+        for (size_t i = 0; i < K; ++i)
+            ms[i] = &accounts[ids[i]].m;
+        multi_lock<std::mutex> lk(ms.begin(), ms.end());
+        trade(accounts, ids);
+    }
+};
+
+// 返回每秒百万笔交易
+template<typename Locker, size_t K>
+double bench_trade()
+{
+    std::vector<account> accounts(ACCOUNTS);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> ts;
+    for (int t = 0; t < THREADS; ++t)
+    {
+        ts.emplace_back([&, t]{
+            std::mt19937 rng(t * 7919 + K);
+            for (int i = 0; i < TRADES_PER_THREAD; ++i)
+                Locker::run(accounts.data(), pick_players<K>(rng));
+        });
+    }
+    for (auto& t : ts)
+        t.join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long total = 0;
+    for (auto& a : accounts)
+        total += a.gold;
+    if (total != INITIAL_GOLD * ACCOUNTS)
+        cout << "gold not conserved: " << total << endl;
+    return THREADS * TRADES_PER_THREAD / sec / 1e6;
+}
+
+template<size_t K>
+void report()
+{
+    cout << K << "\t " << bench_trade<use_std_lock, K>() << "\t   " << bench_trade<use_multi_lock, K>() << endl;
+}
+
+void f()
+{
+    X a(some_big_object(1)), b(some_big_object(2));
+    swap(a, b);
+    swap(a, a);
+    cout << "after swap: a = " << a.value() << ", b = " << b.value() << endl;
+
+    // 运行时确定个数，超过 16 个时改用堆上的数组
+    std::vector<std::mutex> many(40);
+    std::vector<std::mutex*> ptrs;
+    for (auto& m : many)
+        ptrs.push_back(&m);
+    ptrs.push_back(&many[3]);
+    multi_lock<std::mutex> lk(ptrs.begin(), ptrs.end());
+    cout << "locked " << lk.size() << " of " << ptrs.size() << " mutexes (duplicates removed)" << endl;
+}
+
+// 编译: g++ -std=c++17 -O2 -pthread multi_lock.cpp -o multi_lock
+int main(int argc, char* argv[])
+{
+    f();
+
+    cout << "trades among K players, " << THREADS << " threads, " << ACCOUNTS << " accounts (Mtrades/s)" << endl
+         << "K        std::lock  multi_lock" << endl;
+    report<2>();
+    report<4>();
+    report<8>();
+    report<16>();
+    cout << "Main thread..." << endl;
+    return 0;
+}
@@ -0,0 +1,115 @@
+#ifndef __MULTI_LOCK_H__
+#define __MULTI_LOCK_H__
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+
+/*
+    同时锁住任意多个互斥的 RAII 类，code_3_6.cpp / code_3_9.cpp 用 std::lock 锁两个对象的推广
+
+    std::lock 的做法是"锁住一个，其余 try_lock，失败就全部释放、换一个先锁"，竞争激烈时多个线程可能反复互相让路（活锁），
+    而且只接受编译期确定个数的参数。multi_lock 改为：
+    - 把所有互斥按地址排序并去重（同一个对象出现两次也没问题，例如和自己交换），然后按地址从小到大依次加锁。
+      所有线程都按同一个全局顺序加锁，不可能形成环路等待，因此不会死锁，也从不需要释放已持有的锁重来；
+    - 每把锁先 try_lock 若干次（两次之间的 pause 次数指数增长），持锁时间短时在用户态就能拿到；
+      仍然失败才调用 lock() 阻塞，避免在持有时间长的锁上空转；
+    - 个数在运行时确定，16 个以内不分配内存；析构时按相反顺序解锁，加锁中途抛异常时已加的锁会被释放。
+*/
+
+template<typename Mutex>
+class multi_lock
+{
+private:
+    static const size_t INLINE_LOCKS = 16;
+    static const int TRY_ROUNDS = 6;    // try_lock 次数，之间分别 pause 1, 2, 4, ... 次
+
+    Mutex* inline_locks[INLINE_LOCKS];
+    std::unique_ptr<Mutex*[]> heap_locks;
+    Mutex** locks;
+    size_t count;
+    size_t held;
+
+    static void pause()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    static void acquire(Mutex& m)
+    {
+        for (int round = 0; round < TRY_ROUNDS; ++round)
+        {
+            if (m.try_lock())
+                return;
+            for (int i = 0; i < (1 << round); ++i)
+                pause();
+        }
+        m.lock();
+    }
+
+    void release()
+    {
+        while (held > 0)
+            locks[--held]->unlock();
+    }
+
+    template<typename It>
+    void lock_range(It first, It last)
+    {
+        size_t n = std::distance(first, last);
+        if (n > INLINE_LOCKS)
+        {
+            heap_locks.reset(new Mutex*[n]);
+            locks = heap_locks.get();
+        }
+        count = 0;
+        for (; first != last; ++first)
+            locks[count++] = &static_cast<Mutex&>(**first);
+        // 按地址排序（std::less 对任意指针给出全序），去掉重复的互斥
+        std::sort(locks, locks + count, std::less<Mutex*>());
+        count = std::unique(locks, locks + count) - locks;
+        try
+        {
+            for (held = 0; held < count; ++held)
+                acquire(*locks[held]);
+        }
+        catch (...)
+        {
+            release();
+            throw;
+        }
+    }
+
+public:
+    // 元素解引用后是 Mutex&（例如 Mutex* 的容器）
+    template<typename It>
+    multi_lock(It first, It last) : locks(inline_locks), count(0), held(0)
+    {
+        lock_range(first, last);
+    }
+
+    multi_lock(std::initializer_list<Mutex*> ms) : locks(inline_locks), count(0), held(0)
+    {
+        lock_range(ms.begin(), ms.end());
+    }
+
+    ~multi_lock()
+    {
+        release();
+    }
+
+    multi_lock(const multi_lock&) = delete;
+    multi_lock& operator=(const multi_lock&) = delete;
+
+    // 去重后实际持有的锁数
+    size_t size() const
+    {
+        return count;
+    }
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include <map>
+#include <chrono>
+
+#include "profiled_mutex.h"
+
+using namespace std;
+
+/*
+    profiled_mutex.h 的演示：模拟一个服务器里的几类锁，跑一段时间后输出竞争最严重的锁点
+    - 全局统计锁：每个请求都要拿，持有时间很短，但所有线程都抢它；
+    - 会话表分片锁：16 把锁共用一个锁点，竞争分散；
+    - 配置读写锁：绝大多数是读；
+    - 层级互斥：房间锁（高层）内再拿玩家锁（低层）。
+    另外测一下无竞争时 profiled_mutex 相对 std::mutex 多出的开销。
+*/
+
+const int THREADS = 8;
+const int REQUESTS_PER_THREAD = 200000;
+const int SESSION_SHARDS = 16;
+
+profiled_mutex stats_mutex("global stats");
+long request_count = 0;
+
+std::vector<profiled_mutex*> session_mutexes;
+std::map<int, long> sessions[SESSION_SHARDS];
+
+profiled_shared_mutex config_mutex("config (rw)");
+int config_value = 42;
+
+profiled_hierarchical_mutex room_mutex(10000, "room (h10000)");
+profiled_hierarchical_mutex player_mutex(5000, "player (h5000)");
+long player_score = 0;
+
+void handle_request(int tid, int i)
+{
+    {
+        std::shared_lock<profiled_shared_mutex> lk(config_mutex);
+        if (config_value < 0)
+            return;
+    }
+    {
+        int shard = (tid * 7 + i) % SESSION_SHARDS;
+        std::lock_guard<profiled_mutex> lk(*session_mutexes[shard]);
+        sessions[shard][i % 1024] += i;
+    }
+    if (i % 8 == 0)
+    {
+        std::lock_guard<profiled_hierarchical_mutex> room(room_mutex);
+        std::lock_guard<profiled_hierarchical_mutex> player(player_mutex);
+        for (int k = 0; k < 50; ++k)
+            player_score += k;
+    }
+    if (i % 1000 == 0)
+    {
+        std::lock_guard<profiled_shared_mutex> lk(config_mutex);
+        ++config_value;
+    }
+    std::lock_guard<profiled_mutex> lk(stats_mutex);
+    ++request_count;
+}
+
+// 单线程无竞争时每次加解锁的耗时（纳秒）
+template<typename Mutex>
+double uncontended_ns(Mutex& m)
+{
+    const int N = 5000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; ++i)
+    {
+        m.lock();
+        m.unlock();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N;
+}
+
+// 编译: g++ -std=c++17 -O2 -pthread profiled_mutex.cpp -o profiled_mutex
+int main(int argc, char* argv[])
+{
+    for (int i = 0; i < SESSION_SHARDS; ++i)
+        session_mutexes.push_back(new profiled_mutex("session shard"));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([t]{
+            for (int i = 0; i < REQUESTS_PER_THREAD; ++i)
+                handle_request(t, i);
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    cout << "requests: " << request_count << endl;
+    lock_profiler::dump(cout, 5);
+
+    std::mutex plain;
+    profiled_mutex profiled("overhead test");
+    cout << "uncontended lock+unlock: std::mutex " << uncontended_ns(plain) << " ns, profiled_mutex "
+         << uncontended_ns(profiled) << " ns" << endl;
+
+    for (auto m : session_mutexes)
+        delete m;
+    cout << "Main thread..." << endl;
+    return 0;
+}
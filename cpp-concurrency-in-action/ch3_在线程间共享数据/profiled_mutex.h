@@ -0,0 +1,407 @@
+#ifndef __PROFILED_MUTEX_H__
+#define __PROFILED_MUTEX_H__
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+    带竞争统计的互斥族：profiled_mutex / profiled_shared_mutex / profiled_hierarchical_mutex
+
+    code_3_8.cpp 的 hierarchical_mutex 只检查加锁顺序，看不出哪把锁真正拖慢了吞吐。这里的互斥按"锁点"记账：
+    每个锁点有一个名字（同名的多把锁，例如分片锁，合并为一个锁点），记录加锁次数、发生竞争的次数、等待时间和持有时间。
+    - 加锁先 try_lock，成功就是无竞争的快速路径，只加一次计数；失败才读两次 rdtsc 计时阻塞等待的时间。
+      竞争路径本来就要阻塞，计时的开销可以忽略；
+    - 持有时间按线程抽样：每个线程每 SAMPLE_EVERY 次加锁计一次时，汇总时按比例估算总量；
+    - 计数都记在线程自己的表里（只有本线程写，relaxed 原子变量的 load + store，不是原子读改写），
+      没有跨线程共享的缓存行；dump 时把所有线程的表加起来，线程退出时把它的计数并入全局；
+    - lock_profiler::dump(os, n) 按总等待时间输出竞争最严重的 n 个锁点，周期数按启动时校准的 TSC 频率换算成时间。
+    三种互斥都满足 Lockable 要求，可以直接换掉 std::mutex / std::shared_mutex / hierarchical_mutex。
+*/
+
+namespace lock_profiler
+{
+
+const size_t MAX_SITES = 1024;
+const unsigned SAMPLE_EVERY = 16;
+
+inline uint64_t read_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// 只由一个线程写的计数：load + store，不产生原子读改写
+inline void bump(std::atomic<uint64_t>& c, uint64_t d = 1)
+{
+    c.store(c.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+}
+
+struct site_counters
+{
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> wait_cycles{0};
+    std::atomic<uint64_t> max_wait_cycles{0};
+    std::atomic<uint64_t> hold_samples{0};
+    std::atomic<uint64_t> hold_cycles{0};
+};
+
+struct site_totals
+{
+    uint64_t acquisitions = 0, contended = 0, wait_cycles = 0, max_wait_cycles = 0, hold_samples = 0, hold_cycles = 0;
+
+    void add(const site_counters& c)
+    {
+        acquisitions += c.acquisitions.load(std::memory_order_relaxed);
+        contended += c.contended.load(std::memory_order_relaxed);
+        wait_cycles += c.wait_cycles.load(std::memory_order_relaxed);
+        max_wait_cycles = std::max<uint64_t>(max_wait_cycles, c.max_wait_cycles.load(std::memory_order_relaxed));
+        hold_samples += c.hold_samples.load(std::memory_order_relaxed);
+        hold_cycles += c.hold_cycles.load(std::memory_order_relaxed);
+    }
+};
+
+struct thread_stats;
+
+// 锁点名字表、在世线程的计数表、已退出线程的累计值
+struct registry
+{
+    std::mutex m;
+    std::map<std::string, size_t> site_ids;
+    std::vector<std::string> site_names;
+    std::vector<thread_stats*> threads;
+    site_totals retired[MAX_SITES];
+    double cycles_per_ns;
+
+    registry()
+    {
+        // 校准 TSC 频率
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = read_tsc();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        uint64_t c1 = read_tsc();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        cycles_per_ns = (c1 - c0) / ns;
+    }
+
+    static registry& get()
+    {
+        static registry r;
+        return r;
+    }
+
+    size_t site_id(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lk(m);
+        auto it = site_ids.find(name);
+        if (it != site_ids.end())
+            return it->second;
+        if (site_names.size() == MAX_SITES)
+            throw std::length_error("too many lock sites");
+        site_ids[name] = site_names.size();
+        site_names.push_back(name);
+        return site_names.size() - 1;
+    }
+};
+
+struct thread_stats
+{
+    site_counters sites[MAX_SITES];
+    unsigned sample_tick = 0;
+    // 本线程正在计时的共享锁：(锁地址, 加锁时的 TSC)
+    static const int MAX_SHARED_HELD = 16;
+    const void* shared_held[MAX_SHARED_HELD] = {};
+    uint64_t shared_since[MAX_SHARED_HELD] = {};
+
+    thread_stats()
+    {
+        registry& r = registry::get();
+        std::lock_guard<std::mutex> lk(r.m);
+        r.threads.push_back(this);
+    }
+
+    ~thread_stats()
+    {
+        registry& r = registry::get();
+        std::lock_guard<std::mutex> lk(r.m);
+        for (size_t i = 0; i < MAX_SITES; ++i)
+            r.retired[i].add(sites[i]);
+        r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+    }
+
+    static thread_stats& local()
+    {
+        thread_local static thread_stats s;
+        return s;
+    }
+
+    bool sample()
+    {
+        return ++sample_tick % SAMPLE_EVERY == 0;
+    }
+};
+
+// 加锁：先 try_lock，失败时计时等待；返回是否对持有时间抽样
+template<typename TryLock, typename Lock>
+inline bool record_lock(size_t site, TryLock try_lock, Lock lock)
+{
+    thread_stats& ts = thread_stats::local();
+    site_counters& c = ts.sites[site];
+    bump(c.acquisitions);
+    if (!try_lock())
+    {
+        uint64_t t0 = read_tsc();
+        lock();
+        uint64_t wait = read_tsc() - t0;
+        bump(c.contended);
+        bump(c.wait_cycles, wait);
+        if (wait > c.max_wait_cycles.load(std::memory_order_relaxed))
+            c.max_wait_cycles.store(wait, std::memory_order_relaxed);
+    }
+    return ts.sample();
+}
+
+inline void record_hold(size_t site, uint64_t since)
+{
+    site_counters& c = thread_stats::local().sites[site];
+    bump(c.hold_samples);
+    bump(c.hold_cycles, read_tsc() - since);
+}
+
+// 按总等待时间从大到小输出前 top_n 个锁点
+inline void dump(std::ostream& os, size_t top_n = 10)
+{
+    registry& r = registry::get();
+    std::vector<std::pair<std::string, site_totals>> rows;
+    {
+        std::lock_guard<std::mutex> lk(r.m);
+        for (size_t i = 0; i < r.site_names.size(); ++i)
+        {
+            site_totals t = r.retired[i];
+            for (thread_stats* ts : r.threads)
+                t.add(ts->sites[i]);
+            rows.emplace_back(r.site_names[i], t);
+        }
+    }
+    std::sort(rows.begin(), rows.end(), [](const std::pair<std::string, site_totals>& a, const std::pair<std::string, site_totals>& b) {
+        return a.second.wait_cycles > b.second.wait_cycles;
+    });
+    const double cpn = r.cycles_per_ns;
+    os << std::left << std::setw(24) << "lock site" << std::right
+       << std::setw(12) << "acquires" << std::setw(11) << "contended" << std::setw(9) << "rate"
+       << std::setw(13) << "wait(ms)" << std::setw(14) << "avg wait(us)" << std::setw(14) << "max wait(us)"
+       << std::setw(15) << "est hold(ms)" << std::endl;
+    for (size_t i = 0; i < rows.size() && i < top_n; ++i)
+    {
+        const site_totals& t = rows[i].second;
+        double hold_ms = t.hold_samples ? t.hold_cycles / cpn / 1e6 * t.acquisitions / t.hold_samples : 0;
+        os << std::left << std::setw(24) << rows[i].first << std::right << std::fixed << std::setprecision(2)
+           << std::setw(12) << t.acquisitions
+           << std::setw(11) << t.contended
+           << std::setw(8) << (t.acquisitions ? 100.0 * t.contended / t.acquisitions : 0) << "%"
+           << std::setw(13) << t.wait_cycles / cpn / 1e6
+           << std::setw(14) << (t.contended ? t.wait_cycles / cpn / 1e3 / t.contended : 0)
+           << std::setw(14) << t.max_wait_cycles / cpn / 1e3
+           << std::setw(15) << hold_ms << std::endl;
+    }
+    os.unsetf(std::ios::fixed);
+}
+
+}   // namespace lock_profiler
+
+// 互斥锁
+class profiled_mutex
+{
+    std::mutex m;
+    const size_t site;
+    uint64_t acquired_at;   // 只由持锁线程读写
+    bool sampled;
+
+public:
+    explicit profiled_mutex(const std::string& name) : site(lock_profiler::registry::get().site_id(name)), acquired_at(0), sampled(false) {}
+
+    profiled_mutex(const profiled_mutex&) = delete;
+    profiled_mutex& operator=(const profiled_mutex&) = delete;
+
+    void lock()
+    {
+        sampled = lock_profiler::record_lock(site, [this]{ return m.try_lock(); }, [this]{ m.lock(); });
+        if (sampled)
+            acquired_at = lock_profiler::read_tsc();
+    }
+
+    bool try_lock()
+    {
+        if (!m.try_lock())
+            return false;
+        lock_profiler::bump(lock_profiler::thread_stats::local().sites[site].acquisitions);
+        sampled = false;
+        return true;
+    }
+
+    void unlock()
+    {
+        if (sampled)
+            lock_profiler::record_hold(site, acquired_at);
+        m.unlock();
+    }
+};
+
+// 读写锁：独占和共享加锁记在同一个锁点上
+class profiled_shared_mutex
+{
+    std::shared_mutex m;
+    const size_t site;
+    uint64_t acquired_at;
+    bool sampled;
+
+public:
+    explicit profiled_shared_mutex(const std::string& name) : site(lock_profiler::registry::get().site_id(name)), acquired_at(0), sampled(false) {}
+
+    profiled_shared_mutex(const profiled_shared_mutex&) = delete;
+    profiled_shared_mutex& operator=(const profiled_shared_mutex&) = delete;
+
+    void lock()
+    {
+        sampled = lock_profiler::record_lock(site, [this]{ return m.try_lock(); }, [this]{ m.lock(); });
+        if (sampled)
+            acquired_at = lock_profiler::read_tsc();
+    }
+
+    bool try_lock()
+    {
+        if (!m.try_lock())
+            return false;
+        lock_profiler::bump(lock_profiler::thread_stats::local().sites[site].acquisitions);
+        sampled = false;
+        return true;
+    }
+
+    void unlock()
+    {
+        if (sampled)
+            lock_profiler::record_hold(site, acquired_at);
+        m.unlock();
+    }
+
+    // 多个读者同时持有，加锁时间记在线程自己的表里
+    void lock_shared()
+    {
+        if (lock_profiler::record_lock(site, [this]{ return m.try_lock_shared(); }, [this]{ m.lock_shared(); }))
+        {
+            lock_profiler::thread_stats& ts = lock_profiler::thread_stats::local();
+            for (int i = 0; i < lock_profiler::thread_stats::MAX_SHARED_HELD; ++i)
+            {
+                if (!ts.shared_held[i])
+                {
+                    ts.shared_held[i] = this;
+                    ts.shared_since[i] = lock_profiler::read_tsc();
+                    break;
+                }
+            }
+        }
+    }
+
+    bool try_lock_shared()
+    {
+        if (!m.try_lock_shared())
+            return false;
+        lock_profiler::bump(lock_profiler::thread_stats::local().sites[site].acquisitions);
+        return true;
+    }
+
+    void unlock_shared()
+    {
+        lock_profiler::thread_stats& ts = lock_profiler::thread_stats::local();
+        for (int i = 0; i < lock_profiler::thread_stats::MAX_SHARED_HELD; ++i)
+        {
+            if (ts.shared_held[i] == this)
+            {
+                ts.shared_held[i] = nullptr;
+                lock_profiler::record_hold(site, ts.shared_since[i]);
+                break;
+            }
+        }
+        m.unlock_shared();
+    }
+};
+
+// 代码清单 3.8 的层级互斥，内部换成 profiled_mutex；默认以层级编号命名锁点
+class profiled_hierarchical_mutex
+{
+    profiled_mutex internal_mutex;
+    unsigned long const hierarchy_value;
+    unsigned long previous_hierarchy_value;
+
+    static inline thread_local unsigned long this_thread_hierarchy_value = ULONG_MAX;
+
+    void check_for_hierarchy_violation()
+    {
+        if (this_thread_hierarchy_value <= hierarchy_value)
+        {
+            throw std::logic_error("mutex hierarchy violated");
+        }
+    }
+
+    void update_heirarchy_value()
+    {
+        previous_hierarchy_value = this_thread_hierarchy_value;
+        this_thread_hierarchy_value = hierarchy_value;
+    }
+
+public:
+    explicit profiled_hierarchical_mutex(unsigned long value)
+        : internal_mutex("hierarchy " + std::to_string(value)), hierarchy_value(value), previous_hierarchy_value(0)
+    {}
+
+    profiled_hierarchical_mutex(unsigned long value, const std::string& name)
+        : internal_mutex(name), hierarchy_value(value), previous_hierarchy_value(0)
+    {}
+
+    void lock()
+    {
+        check_for_hierarchy_violation();
+        internal_mutex.lock();
+        update_heirarchy_value();
+    }
+
+    void unlock()
+    {
+        if (this_thread_hierarchy_value != hierarchy_value)
+        {
+            throw std::logic_error("mutex hierarchy violated");
+        }
+        this_thread_hierarchy_value = previous_hierarchy_value;
+        internal_mutex.unlock();
+    }
+
+    bool try_lock()
+    {
+        check_for_hierarchy_violation();
+        if (!internal_mutex.try_lock())
+            return false;
+        update_heirarchy_value();
+        return true;
+    }
+};
+
+#endif
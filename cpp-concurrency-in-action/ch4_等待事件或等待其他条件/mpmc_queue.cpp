@@ -0,0 +1,384 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <vector>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+using namespace std;
+
+/*
+    有界 MPMC 环形队列（Vyukov 的序号数组算法）+ 可替换的等待策略
+
+    condition_variable.cpp 每个元素都要加锁一次、push 一次 notify_one，每秒百万级消息时 futex 调用太多。
+    - 每个槽位带一个序号 seq：seq == pos 表示槽位空闲、可写入第 pos 个元素；seq == pos + 1 表示已写入、可读出。
+      生产者/消费者各自只 CAS 一个位置计数（enqueue_pos / dequeue_pos），然后用 seq 的 release/acquire 交接数据，
+      没有锁，不同槽位之间互不等待；两个位置计数和槽位数组都按缓存行对齐，避免伪共享；
+    - 队列空或满时的等待方式由策略类决定：
+        spin_wait        一直自旋（pause 指令），延迟最低，但会占满一个核，线程数不能超过核数；
+        spin_yield_wait  先自旋一段时间，仍未就绪就 yield 让出 CPU；
+        futex_wait       自旋一段时间后用 futex 睡眠（eventcount）。每次 push/pop 之后都检查对面是否登记了睡眠，
+                        有才推进 epoch、清掉登记并唤醒全部睡眠者，之后的 push/pop 在有人重新登记之前都不再进内核。
+                        登记后用位置计数（claim 时 seq_cst 的 CAS）再确认一次队列确实空/满，
+                        与 notify 中 seq_cst 的读构成 Dekker 式的配对，快速路径上只多一次普通读，不需要额外的 fence。
+                        不能只在"空 -> 非空"时通知：多个消费者时，某次 push 看到队列非空而不通知，
+                        紧接着前面的元素被另一个消费者取走，睡着的消费者就再也等不到唤醒。
+    - 批量接口 try_push_bulk/try_pop_bulk 用一次 CAS 认领连续的多个槽位，一批只通知一次。
+*/
+
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+const int SPIN_LIMIT = 128;
+
+// 一直自旋，直到 ready() 返回 true
+struct spin_wait
+{
+    static const bool parks = false;
+    template<typename Ready, typename Blocked>
+    void wait(Ready ready, Blocked)
+    {
+        while (!ready())
+            cpu_relax();
+    }
+    void notify() {}
+};
+
+// 先自旋 SPIN_LIMIT 次，之后每次检查前 yield
+struct spin_yield_wait
+{
+    static const bool parks = false;
+    template<typename Ready, typename Blocked>
+    void wait(Ready ready, Blocked)
+    {
+        for (int i = 0; !ready(); ++i)
+        {
+            if (i < SPIN_LIMIT)
+                cpu_relax();
+            else
+                std::this_thread::yield();
+        }
+    }
+    void notify() {}
+};
+
+// 自旋后用 futex 睡在 state 上：state 的最低位表示有线程登记了睡眠，其余位是 epoch
+// notify 在每次 push/pop 后由队列调用，没有人登记时不写共享变量、不进内核
+// blocked() 由队列提供，只读位置计数判断队列是否仍然空/满：认领了但尚未写完的槽位算作非空/非满，此时继续自旋而不睡
+struct futex_wait
+{
+    static const bool parks = true;
+    alignas(64) std::atomic<uint32_t> state{0};
+    std::atomic<unsigned long> wakes{0};    // futex_wake 调用次数，用于观察
+
+    template<typename Ready, typename Blocked>
+    void wait(Ready ready, Blocked blocked)
+    {
+        for (int i = 0; i < SPIN_LIMIT; ++i)
+        {
+            if (ready())
+                return;
+            cpu_relax();
+        }
+        while (true)
+        {
+            // 先登记再检查（都是 seq_cst）：对面认领位置的 CAS 要么先于登记、被 blocked() 看到，
+            // 要么晚于登记，那么它之后 notify 中的读一定看到登记位
+            uint32_t s = state.fetch_or(1) | 1;
+            if (ready())
+                return;
+            if (!blocked())
+            {
+                cpu_relax();
+                continue;
+            }
+            // 登记之后 notify 推进过 epoch 时 state 已经变了，futex_wait 立即返回
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state), FUTEX_WAIT_PRIVATE, s, nullptr, nullptr, 0);
+        }
+    }
+
+    void notify()
+    {
+        uint32_t s = state.load();
+        // 加一同时清掉登记位并推进 epoch；CAS 失败说明另一个 notify 已经做了，由它负责唤醒
+        if ((s & 1) == 0 || !state.compare_exchange_strong(s, s + 1))
+            return;
+        ++wakes;
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+};
+
+template<typename T, typename Wait = futex_wait>
+class mpmc_queue
+{
+private:
+    struct alignas(64) cell
+    {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    const size_t mask;
+    cell* const buffer;
+    alignas(64) std::atomic<size_t> enqueue_pos;
+    alignas(64) std::atomic<size_t> dequeue_pos;
+    alignas(64) Wait not_empty;     // 消费者在这里等
+    alignas(64) Wait not_full;      // 生产者在这里等
+
+    // 认领从 pos 开始最多 n 个连续的就绪槽位（生产者要求 seq == pos + i，消费者要求 seq == pos + i + 1）
+    // 返回认领到的个数和起始位置；0 表示当前没有就绪的槽位
+    size_t claim(std::atomic<size_t>& position, size_t n, size_t ready_offset, size_t& start)
+    {
+        if (n == 0)
+            return 0;
+        size_t pos = position.load(std::memory_order_relaxed);
+        while (true)
+        {
+            size_t k = 0;
+            while (k < n)
+            {
+                size_t seq = buffer[(pos + k) & mask].seq.load(std::memory_order_acquire);
+                if (seq != pos + k + ready_offset)
+                    break;
+                ++k;
+            }
+            if (k == 0)
+            {
+                // 槽位还没轮到：要么队列空/满，要么其他线程已经推进了位置计数
+                size_t seq = buffer[pos & mask].seq.load(std::memory_order_acquire);
+                if (static_cast<ptrdiff_t>(seq - (pos + ready_offset)) < 0)
+                    return 0;
+                pos = position.load(std::memory_order_relaxed);
+                continue;
+            }
+            // seq_cst：与 futex_wait 的登记配对，见 futex_wait::wait
+            if (position.compare_exchange_weak(pos, pos + k, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                start = pos;
+                return k;
+            }
+        }
+    }
+
+public:
+    // capacity 必须是 2 的幂
+    explicit mpmc_queue(size_t capacity)
+        : mask(capacity - 1), buffer(new cell[capacity]), enqueue_pos(0), dequeue_pos(0)
+    {
+        for (size_t i = 0; i < capacity; ++i)
+            buffer[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    ~mpmc_queue()
+    {
+        delete[] buffer;
+    }
+
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+    // 最多写入 n 个元素，返回实际写入的个数（队列满时可能少于 n）
+    size_t try_push_bulk(const T* items, size_t n)
+    {
+        size_t pos;
+        size_t k = claim(enqueue_pos, n, 0, pos);
+        for (size_t i = 0; i < k; ++i)
+        {
+            cell& c = buffer[(pos + i) & mask];
+            c.data = items[i];
+            c.seq.store(pos + i + 1, std::memory_order_release);
+        }
+        if (Wait::parks && k > 0)
+            not_empty.notify();
+        return k;
+    }
+
+    // 最多取出 n 个元素，返回实际取出的个数
+    size_t try_pop_bulk(T* out, size_t n)
+    {
+        size_t pos;
+        size_t k = claim(dequeue_pos, n, 1, pos);
+        for (size_t i = 0; i < k; ++i)
+        {
+            cell& c = buffer[(pos + i) & mask];
+            out[i] = std::move(c.data);
+            c.seq.store(pos + i + mask + 1, std::memory_order_release);
+        }
+        if (Wait::parks && k > 0)
+            not_full.notify();
+        return k;
+    }
+
+    // 只看位置计数：已被认领的槽位算作已占用/已取走
+    bool empty() const
+    {
+        size_t head = dequeue_pos.load();
+        return static_cast<ptrdiff_t>(enqueue_pos.load() - head) <= 0;
+    }
+
+    bool full() const
+    {
+        size_t head = dequeue_pos.load();
+        return static_cast<ptrdiff_t>(enqueue_pos.load() - head) > static_cast<ptrdiff_t>(mask);
+    }
+
+    bool try_push(const T& item) { return try_push_bulk(&item, 1) == 1; }
+    bool try_pop(T& item) { return try_pop_bulk(&item, 1) == 1; }
+
+    // 队列满时按等待策略等待
+    void push(const T& item)
+    {
+        if (!try_push(item))
+            not_full.wait([&]{ return try_push(item); }, [this]{ return full(); });
+    }
+
+    void push_bulk(const T* items, size_t n)
+    {
+        size_t done = try_push_bulk(items, n);
+        while (done < n)
+            not_full.wait([&]{ done += try_push_bulk(items + done, n - done); return done == n; }, [this]{ return full(); });
+    }
+
+    // 队列空时按等待策略等待
+    void pop(T& item)
+    {
+        if (!try_pop(item))
+            not_empty.wait([&]{ return try_pop(item); }, [this]{ return empty(); });
+    }
+
+    unsigned long futex_wakes() const
+    {
+        return parks_wakes(not_empty) + parks_wakes(not_full);
+    }
+
+private:
+    static unsigned long parks_wakes(const futex_wait& w) { return w.wakes.load(); }
+    template<typename W>
+    static unsigned long parks_wakes(const W&) { return 0; }
+};
+
+// 对照组：condition_variable.cpp 的做法，每个元素加锁一次、push 一次 notify_one
+template<typename T>
+class cv_queue
+{
+    std::mutex m;
+    std::queue<T> q;
+    std::condition_variable cond;
+
+public:
+    explicit cv_queue(size_t) {}
+    void push(const T& item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            q.push(item);
+        }
+        cond.notify_one();
+    }
+    void push_bulk(const T* items, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            push(items[i]);
+    }
+    void pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m);
+        cond.wait(lock, [this]{ return !q.empty(); });
+        item = q.front();
+        q.pop();
+    }
+    unsigned long futex_wakes() const { return 0; }
+};
+
+const long TOTAL_MSGS = 1 << 21;
+const size_t QUEUE_CAPACITY = 1024;
+const size_t BATCH = 32;
+
+// producers 个线程共发送 TOTAL_MSGS 条消息（batch > 1 时按批发送），consumers 个线程逐条接收，-1 为结束标记
+// 返回每秒百万条消息数，并校验收到的总和
+template<typename Queue>
+double bench(int producers, int consumers, size_t batch, unsigned long& wakes)
+{
+    Queue q(QUEUE_CAPACITY);
+    std::atomic<long long> sum(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&q, &sum]{
+            long long local = 0;
+            long v;
+            while (true)
+            {
+                q.pop(v);
+                if (v < 0)
+                    break;
+                local += v;
+            }
+            sum += local;
+        });
+    }
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&q, p, producers, batch]{
+            std::vector<long> buf;
+            for (long i = p; i < TOTAL_MSGS; i += producers)
+            {
+                buf.push_back(i);
+                if (buf.size() == batch)
+                {
+                    q.push_bulk(buf.data(), buf.size());
+                    buf.clear();
+                }
+            }
+            q.push_bulk(buf.data(), buf.size());
+        });
+    }
+    for (int p = 0; p < producers; ++p)
+        threads[consumers + p].join();
+    for (int c = 0; c < consumers; ++c)
+    {
+        long stop = -1;
+        q.push_bulk(&stop, 1);
+    }
+    for (int c = 0; c < consumers; ++c)
+        threads[c].join();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (sum != (long long)TOTAL_MSGS * (TOTAL_MSGS - 1) / 2)
+        cout << "sum mismatch!" << endl;
+    wakes = q.futex_wakes();
+    return TOTAL_MSGS / sec / 1e6;
+}
+
+// 编译: g++ -std=c++17 -O2 -pthread mpmc_queue.cpp -o mpmc_queue
+int main(int argc, char* argv[])
+{
+    unsigned cores = std::thread::hardware_concurrency();
+    cout << "producers/consumers: Mmsgs/s (futex wakes)" << endl;
+    for (int n = 1; n <= 4; n *= 2)
+    {
+        unsigned long w;
+        cout << n << "P" << n << "C  cv " << bench<cv_queue<long>>(n, n, 1, w);
+        // 纯自旋的线程数超过核数时会互相饿死，跳过
+        if (2u * n <= cores)
+            cout << "  spin " << bench<mpmc_queue<long, spin_wait>>(n, n, 1, w);
+        cout << "  spin+yield " << bench<mpmc_queue<long, spin_yield_wait>>(n, n, 1, w);
+        double f = bench<mpmc_queue<long, futex_wait>>(n, n, 1, w);
+        cout << "  futex " << f << " (" << w << ")";
+        f = bench<mpmc_queue<long, futex_wait>>(n, n, BATCH, w);
+        cout << "  futex+batch" << BATCH << " " << f << " (" << w << ")" << endl;
+    }
+    cout << "Main thread..." << endl;
+    return 0;
+}
@@ -0,0 +1,434 @@
+#include <iostream>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+using namespace std;
+
+/*
+    细粒度锁的线程安全队列
+
+    condition_variable.cpp 和 threadsafe_stack 都用一个互斥保护整个容器，生产者和消费者在同一把锁上串行。
+    这里把队列做成单向链表，头尾各用一把锁：
+    - 链表末尾始终有一个不含数据的虚拟节点（dummy node），push 只修改 tail、pop 只修改 head，
+      队列为空时 head == tail，两端永远不会操作同一个节点，所以 push 只需要 tail_mutex，pop 主要持有 head_mutex；
+    - 节点从 node_pool 分配：每个线程先从自己的缓存取，缓存空了再从全局空闲链表一次取一批，
+      稳定运行后 push/pop 不再调用 new/delete；
+    - pop_all 在 head_mutex 下把整条链一次摘下来，临界区是 O(1) 的，摘下的节点在锁外逐个取值；
+    - 只有确实有消费者在等待时 push 才去 notify，没人等待时不产生 futex 调用。
+*/
+
+// 按节点类型共享的节点池：全局空闲链表 + 每线程缓存，全局锁每 BATCH 次分配/释放才取一次
+template<typename Node>
+class node_pool
+{
+private:
+    static const size_t BATCH = 32;
+
+    struct global_list
+    {
+        std::mutex m;
+        std::vector<Node*> free_nodes;
+        ~global_list()
+        {
+            for (Node* n : free_nodes)
+                delete n;
+        }
+    };
+
+    struct local_cache
+    {
+        std::vector<Node*> nodes;
+        ~local_cache()  // 线程退出时把缓存还给全局链表
+        {
+            global_list& g = global();
+            std::lock_guard<std::mutex> lock(g.m);
+            g.free_nodes.insert(g.free_nodes.end(), nodes.begin(), nodes.end());
+        }
+    };
+
+    static global_list& global()
+    {
+        static global_list g;
+        return g;
+    }
+
+    static local_cache& local()
+    {
+        global();  // 保证全局链表先于线程缓存构造、后于它析构
+        thread_local local_cache c;
+        return c;
+    }
+
+public:
+    static Node* allocate()
+    {
+        local_cache& c = local();
+        if (c.nodes.empty())
+        {
+            global_list& g = global();
+            {
+                std::lock_guard<std::mutex> lock(g.m);
+                size_t n = std::min(BATCH, g.free_nodes.size());
+                c.nodes.assign(g.free_nodes.end() - n, g.free_nodes.end());
+                g.free_nodes.resize(g.free_nodes.size() - n);
+            }
+            while (c.nodes.size() < BATCH)
+                c.nodes.push_back(new Node);
+        }
+        Node* n = c.nodes.back();
+        c.nodes.pop_back();
+        return n;
+    }
+
+    static void deallocate(Node* n)
+    {
+        local_cache& c = local();
+        c.nodes.push_back(n);
+        if (c.nodes.size() >= 2 * BATCH)  // 缓存过多时还一批给全局链表，供其他线程（例如生产者）使用
+        {
+            global_list& g = global();
+            std::lock_guard<std::mutex> lock(g.m);
+            g.free_nodes.insert(g.free_nodes.end(), c.nodes.end() - BATCH, c.nodes.end());
+            c.nodes.resize(c.nodes.size() - BATCH);
+        }
+    }
+};
+
+template<typename T>
+class threadsafe_queue
+{
+private:
+    struct node
+    {
+        alignas(T) unsigned char storage[sizeof(T)];  // 数据就地构造，虚拟节点上不构造
+        node* next;
+        T* value() { return reinterpret_cast<T*>(storage); }
+    };
+    typedef node_pool<node> pool;
+
+    // 头尾各自占一个缓存行，生产者和消费者不会因伪共享互相拖慢
+    alignas(64) std::mutex head_mutex;
+    node* head;
+    std::atomic<int> waiters;
+    std::condition_variable data_cond;
+    alignas(64) std::mutex tail_mutex;
+    node* tail;
+
+    node* get_tail()
+    {
+        std::lock_guard<std::mutex> tail_lock(tail_mutex);
+        return tail;
+    }
+
+    // 持有 head_mutex 时调用，队列非空
+    node* pop_head()
+    {
+        node* old_head = head;
+        head = old_head->next;
+        return old_head;
+    }
+
+    static void take(node* n, T& value)
+    {
+        value = std::move(*n->value());
+        n->value()->~T();
+        pool::deallocate(n);
+    }
+
+public:
+    threadsafe_queue() : head(pool::allocate()), waiters(0), tail(head)
+    {
+        head->next = nullptr;
+    }
+
+    threadsafe_queue(const threadsafe_queue& other) = delete;
+    threadsafe_queue& operator=(const threadsafe_queue& other) = delete;
+
+    ~threadsafe_queue()
+    {
+        while (head != tail)
+        {
+            node* n = pop_head();
+            n->value()->~T();
+            pool::deallocate(n);
+        }
+        pool::deallocate(head);
+    }
+
+    void push(T new_value)
+    {
+        // 新值放进当前的虚拟节点，再挂一个新的虚拟节点。节点分配在锁外，锁内只做一次移动构造；
+        // 数据留在原虚拟节点里，pop 才能在释放 head_mutex 之后再取值
+        node* p = pool::allocate();
+        p->next = nullptr;
+        {
+            std::lock_guard<std::mutex> tail_lock(tail_mutex);
+            try
+            {
+                new (tail->storage) T(std::move(new_value));
+            }
+            catch (...)
+            {
+                pool::deallocate(p);  // 移动构造抛异常时队列不变，新节点还回池中
+                throw;
+            }
+            tail->next = p;
+            tail = p;
+        }
+        if (waiters.load() > 0)
+        {
+            // 经过一次 head_mutex，保证等待者要么还没检查队列（会看到新数据），要么已经在 wait 中（能被唤醒）
+            { std::lock_guard<std::mutex> head_lock(head_mutex); }
+            data_cond.notify_one();
+        }
+    }
+
+    bool try_pop(T& value)
+    {
+        node* old_head;
+        {
+            std::lock_guard<std::mutex> head_lock(head_mutex);
+            if (head == get_tail())
+                return false;
+            old_head = pop_head();
+        }
+        take(old_head, value);  // 取值、析构和归还节点都在锁外
+        return true;
+    }
+
+    void wait_and_pop(T& value)
+    {
+        node* old_head;
+        {
+            std::unique_lock<std::mutex> head_lock(head_mutex);
+            if (head == get_tail())
+            {
+                ++waiters;
+                data_cond.wait(head_lock, [&]{ return head != get_tail(); });
+                --waiters;
+            }
+            old_head = pop_head();
+        }
+        take(old_head, value);
+    }
+
+    // 一次取出队列中的全部元素追加到 out，返回取出的个数
+    size_t pop_all(std::vector<T>& out)
+    {
+        node* first;
+        node* last;
+        {
+            std::lock_guard<std::mutex> head_lock(head_mutex);
+            first = head;
+            last = get_tail();
+            head = last;  // 当前虚拟节点留在队列里，[first, last) 归本线程所有
+        }
+        size_t n = 0;
+        while (first != last)
+        {
+            node* next = first->next;
+            out.push_back(std::move(*first->value()));
+            first->value()->~T();
+            pool::deallocate(first);
+            first = next;
+            ++n;
+        }
+        return n;
+    }
+
+    bool empty()
+    {
+        std::lock_guard<std::mutex> head_lock(head_mutex);
+        return head == get_tail();
+    }
+};
+
+// 对照组：condition_variable.cpp 的做法，一把锁保护 std::queue，每次 push 都 notify
+template<typename T>
+class locked_queue
+{
+private:
+    std::mutex m;
+    std::queue<T> data_queue;
+    std::condition_variable data_cond;
+
+public:
+    void push(T new_value)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            data_queue.push(std::move(new_value));
+        }
+        data_cond.notify_one();
+    }
+
+    bool try_pop(T& value)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        if (data_queue.empty())
+            return false;
+        value = std::move(data_queue.front());
+        data_queue.pop();
+        return true;
+    }
+
+    void wait_and_pop(T& value)
+    {
+        std::unique_lock<std::mutex> lock(m);
+        data_cond.wait(lock, [this]{ return !data_queue.empty(); });
+        value = std::move(data_queue.front());
+        data_queue.pop();
+    }
+};
+
+const int TOTAL_ITEMS = 1 << 20;
+
+// producers 个线程共推入 TOTAL_ITEMS 个值，consumers 个线程用 wait_and_pop 取出，-1 作为结束标记
+// 返回每个元素的平均耗时（纳秒），并校验取出的总和
+template<typename Queue>
+double bench(int producers, int consumers)
+{
+    Queue q;
+    std::atomic<long long> sum(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&q, p, producers]{
+            for (int i = p; i < TOTAL_ITEMS; i += producers)
+                q.push(i);
+        });
+    }
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&q, &sum]{
+            long long local = 0;
+            int v;
+            while (true)
+            {
+                q.wait_and_pop(v);
+                if (v < 0)
+                    break;
+                local += v;
+            }
+            sum += local;
+        });
+    }
+    for (int p = 0; p < producers; ++p)
+        threads[p].join();
+    for (int c = 0; c < consumers; ++c)
+        q.push(-1);
+    for (size_t i = producers; i < threads.size(); ++i)
+        threads[i].join();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (sum != (long long)TOTAL_ITEMS * (TOTAL_ITEMS - 1) / 2)
+        cout << "sum mismatch!" << endl;
+    return ns / TOTAL_ITEMS;
+}
+
+// 单线程先全部推入再全部取出，作为无竞争时的基准
+template<typename Queue>
+double bench_single()
+{
+    Queue q;
+    long long sum = 0;
+    int v;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < TOTAL_ITEMS; ++i)
+        q.push(i);
+    while (q.try_pop(v))
+        sum += v;
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (sum != (long long)TOTAL_ITEMS * (TOTAL_ITEMS - 1) / 2)
+        cout << "sum mismatch!" << endl;
+    return ns / TOTAL_ITEMS;
+}
+
+// 消费者改用 pop_all 批量取出
+double bench_pop_all(int producers, int consumers)
+{
+    threadsafe_queue<int> q;
+    std::atomic<long long> sum(0);
+    std::atomic<int> finished(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&q, p, producers]{
+            for (int i = p; i < TOTAL_ITEMS; i += producers)
+                q.push(i);
+        });
+    }
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&q, &sum, &finished, consumers]{
+            long long local = 0;
+            std::vector<int> batch;
+            while (finished.load() < consumers)
+            {
+                batch.clear();
+                if (q.pop_all(batch) == 0)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (int v : batch)
+                {
+                    if (v < 0)
+                        ++finished;
+                    else
+                        local += v;
+                }
+            }
+            sum += local;
+        });
+    }
+    for (int p = 0; p < producers; ++p)
+        threads[p].join();
+    for (int c = 0; c < consumers; ++c)
+        q.push(-1);
+    for (size_t i = producers; i < threads.size(); ++i)
+        threads[i].join();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (sum != (long long)TOTAL_ITEMS * (TOTAL_ITEMS - 1) / 2)
+        cout << "sum mismatch!" << endl;
+    return ns / TOTAL_ITEMS;
+}
+
+void f()
+{
+    threadsafe_queue<std::string> q;
+    q.push("hello");
+    q.push("world");
+    std::string s;
+    q.wait_and_pop(s);
+    cout << "wait_and_pop: " << s << endl;
+    q.push("!");
+    std::vector<std::string> rest;
+    q.pop_all(rest);
+    cout << "pop_all: " << rest.size() << " items, try_pop on empty: " << q.try_pop(s) << endl;
+}
+
+// 编译: g++ -std=c++17 -O2 -pthread threadsafe_queue.cpp -o threadsafe_queue
+int main(int argc, char* argv[])
+{
+    f();
+    cout << "threads  single-mutex(ns/item)  two-lock(ns/item)  two-lock+pop_all(ns/item)" << endl;
+    cout << 1 << "\t " << bench_single<locked_queue<int>>() << "\t\t\t  " << bench_single<threadsafe_queue<int>>() << endl;
+    for (int n = 2; n <= 64; n *= 2)
+    {
+        int producers = n / 2, consumers = n - n / 2;
+        double a = bench<locked_queue<int>>(producers, consumers);
+        double b = bench<threadsafe_queue<int>>(producers, consumers);
+        double c = bench_pop_all(producers, consumers);
+        cout << n << "\t " << a << "\t\t\t  " << b << "\t\t     " << c << endl;
+    }
+    cout << "Main thread..." << endl;
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#include "parallel_algorithms.h"
+
+using namespace std;
+
+/*
+    parallel_algorithms.h 的正确性检查与耗时对比：每个算法都和对应的串行标准算法比较结果，
+    transform_reduce 另外和 ch2 parallel_accumulate 的写法（静态分块、每次新建线程、结果写进相邻的 vector 元素）对比。
+*/
+
+const size_t N = 1 << 24;
+
+template<typename F>
+double timeit(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ch2 的 parallel_accumulate 做法
+double static_split_sum(const std::vector<double>& v)
+{
+    const size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t block_size = v.size() / num_threads;
+    std::vector<double> results(num_threads);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        threads.emplace_back([&, i]{
+            size_t end = i + 1 == num_threads ? v.size() : (i + 1) * block_size;
+            for (size_t k = i * block_size; k < end; ++k)
+                results[i] += std::sqrt(v[k]);   // 每次都写回共享的 vector 元素
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    return std::accumulate(results.begin(), results.end(), 0.0);
+}
+
+void f()
+{
+    work_stealing_pool& pool = default_pool();
+    cout << "pool threads: " << pool.size() << ", n = " << N << endl;
+
+    std::vector<double> v(N);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> dist(0.0, 1000.0);
+    for (auto& x : v)
+        x = dist(rng);
+
+    // for_each
+    std::vector<double> a = v, b = v;
+    double t_seq = timeit([&]{ std::for_each(a.begin(), a.end(), [](double& x) { x = std::sqrt(x) * 2.0; }); });
+    double t_par = timeit([&]{ parallel_for_each(b.begin(), b.end(), [](double& x) { x = std::sqrt(x) * 2.0; }); });
+    cout << "for_each           seq " << t_seq << " ms, par " << t_par << " ms, " << (a == b ? "ok" : "MISMATCH") << endl;
+
+    // transform_reduce：整数求和，结果与顺序无关，可以精确比较
+    std::vector<long> iv(N);
+    std::iota(iv.begin(), iv.end(), 0);
+    long s1 = 0, s2 = 0;
+    t_seq = timeit([&]{ for (long x : iv) s1 += x * x % 7; });
+    t_par = timeit([&]{ s2 = parallel_transform_reduce(iv.begin(), iv.end(), 0L, std::plus<long>(), [](long x) { return x * x % 7; }); });
+    cout << "transform_reduce   seq " << t_seq << " ms, par " << t_par << " ms, " << (s1 == s2 ? "ok" : "MISMATCH") << endl;
+
+    double d1 = 0, d2 = 0;
+    t_seq = timeit([&]{ d1 = static_split_sum(v); });
+    t_par = timeit([&]{ d2 = parallel_transform_reduce(v.begin(), v.end(), 0.0, std::plus<double>(), [](double x) { return std::sqrt(x); }); });
+    cout << "sum of sqrt        static split " << t_seq << " ms, par " << t_par << " ms, "
+         << (std::fabs(d1 - d2) < 1e-6 * d1 ? "ok" : "MISMATCH") << endl;
+
+    // inclusive_scan
+    std::vector<long> o1(N), o2(N);
+    t_seq = timeit([&]{ std::partial_sum(iv.begin(), iv.end(), o1.begin()); });
+    t_par = timeit([&]{ parallel_inclusive_scan(iv.begin(), iv.end(), o2.begin()); });
+    cout << "inclusive_scan     seq " << t_seq << " ms, par " << t_par << " ms, " << (o1 == o2 ? "ok" : "MISMATCH") << endl;
+
+    // sort
+    a = v;
+    b = v;
+    t_seq = timeit([&]{ std::sort(a.begin(), a.end()); });
+    t_par = timeit([&]{ parallel_sort(b.begin(), b.end()); });
+    cout << "sort               seq " << t_seq << " ms, par " << t_par << " ms, " << (a == b ? "ok" : "MISMATCH") << endl;
+
+    // find_if：目标在 3/4 处，另在末尾放一个，检查返回的是第一个
+    iv[N * 3 / 4] = -1;
+    iv[N - 1] = -1;
+    auto it1 = iv.end(), it2 = iv.end();
+    t_seq = timeit([&]{ it1 = std::find_if(iv.begin(), iv.end(), [](long x) { return x < 0; }); });
+    t_par = timeit([&]{ it2 = parallel_find_if(iv.begin(), iv.end(), [](long x) { return x < 0; }); });
+    cout << "find_if            seq " << t_seq << " ms, par " << t_par << " ms, " << (it1 == it2 ? "ok" : "MISMATCH") << endl;
+    it2 = parallel_find_if(iv.begin(), iv.end(), [](long x) { return x == -2; });
+    cout << "find_if not found: " << (it2 == iv.end() ? "ok" : "MISMATCH") << endl;
+}
+
+// 编译: g++ -std=c++17 -O2 -pthread parallel_algorithms.cpp -o parallel_algorithms
+int main(int argc, char* argv[])
+{
+    f();
+    cout << "Main thread..." << endl;
+    return 0;
+}
@@ -0,0 +1,302 @@
+#ifndef __PARALLEL_ALGORITHMS_H__
+#define __PARALLEL_ALGORITHMS_H__
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+#include "work_stealing_pool.h"
+
+/*
+    基于 work_stealing_pool 的并行算法：
+        parallel_for_each / parallel_transform_reduce / parallel_inclusive_scan / parallel_sort / parallel_find_if
+
+    parallel_accumulate 写死 min_per_thread = 25，一次性静态分块、每次新建线程再全部 join，
+    各线程的结果写进相邻的 vector<T> 元素里（同一缓存行被多个核反复写，伪共享）。这里：
+    - 运行在常驻线程池上，不创建线程；
+    - 自适应拆分：区间大于粒度就对半拆，右半提交到本线程的本地队列（空闲线程会把它偷走），左半自己继续处理，
+      负载不均时空闲线程不断偷走大块，不依赖事先按线程数静态切分；
+    - 自动确定粒度：先在区间开头串行处理 1、2、4…个元素并计时，直到一次耗时超过 GRAIN_PROBE_NS，
+      由此估算出单个叶子任务耗时约 GRAIN_TARGET_NS 的元素个数；探测时处理的元素就是结果的一部分，不做无用功；
+    - 归约的中间结果沿递归返回，扫描的块和、查找的最小下标等需要多个线程写的变量都按缓存行对齐（padded<T>）。
+    迭代器要求是随机访问迭代器，元素类型要求可默认构造；异常会通过 future 传回调用方。
+*/
+
+const long GRAIN_PROBE_NS = 10000;      // 探测到单次耗时超过 10us 为止
+const long GRAIN_TARGET_NS = 50000;     // 每个叶子任务的目标耗时 50us，远大于一次任务提交/窃取的开销
+const size_t SORT_MIN_GRAIN = 4096;     // 小于这个长度直接 std::sort
+
+// 独占一个缓存行的变量
+template<typename T>
+struct alignas(64) padded
+{
+    T value;
+};
+
+// ---------------------------------------------------------------- 拆分与粒度
+
+// 左半抛异常时，提交出去的右半还引用着调用方栈上的变量，离开作用域前必须等它结束
+template<typename R>
+struct task_join_guard
+{
+    work_stealing_pool& pool;
+    std::future<R>& f;
+    ~task_join_guard()
+    {
+        if (f.valid())
+        {
+            try { pool.wait(f); } catch (...) {}
+        }
+    }
+};
+
+// 对 [lo, hi) 递归二分，直到长度不超过 grain，对每个叶子调用 body(lo, hi)
+template<typename Body>
+void parallel_range(work_stealing_pool& pool, size_t lo, size_t hi, size_t grain, const Body& body)
+{
+    if (hi - lo <= grain)
+    {
+        body(lo, hi);
+        return;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    std::future<void> right = pool.submit([&pool, mid, hi, grain, &body]{ parallel_range(pool, mid, hi, grain, body); });
+    task_join_guard<void> guard{pool, right};
+    parallel_range(pool, lo, mid, grain, body);
+    pool.wait(right);
+}
+
+// 同上，叶子返回部分结果 leaf(lo, hi)，按从左到右的顺序用 combine 合并（combine 只需满足结合律）
+template<typename T, typename Leaf, typename Combine>
+T parallel_reduce_range(work_stealing_pool& pool, size_t lo, size_t hi, size_t grain, const Leaf& leaf, const Combine& combine)
+{
+    if (hi - lo <= grain)
+        return leaf(lo, hi);
+    size_t mid = lo + (hi - lo) / 2;
+    std::future<T> right = pool.submit([&pool, mid, hi, grain, &leaf, &combine]{
+        return parallel_reduce_range<T>(pool, mid, hi, grain, leaf, combine);
+    });
+    task_join_guard<T> guard{pool, right};
+    T left = parallel_reduce_range<T>(pool, lo, mid, grain, leaf, combine);
+    return combine(std::move(left), pool.wait(right));
+}
+
+// 在 [0, n) 的开头串行调用 probe(lo, hi)，每次长度翻倍，直到单次耗时超过 GRAIN_PROBE_NS。
+// done 返回已处理的元素个数；probe 返回 false 表示可以提前结束（find_if 已经找到）
+// 返回值为剩余区间的粒度：不小于 1，不大于剩余长度 / (线程数 * 4)，保证至少有几倍于线程数的叶子可以被窃取
+template<typename Probe>
+size_t detect_grain(size_t n, size_t threads, const Probe& probe, size_t& done)
+{
+    done = 0;
+    size_t k = 1;
+    long elapsed = 0;
+    const size_t probe_limit = n / (threads * 8);
+    while (done + k <= probe_limit)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool go_on = probe(done, done + k);
+        elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        done += k;
+        if (!go_on || elapsed >= GRAIN_PROBE_NS)
+            break;
+        k *= 2;
+    }
+    // 区间太短、没有做探测时，平均分给各线程
+    if (done == 0)
+        return std::max<size_t>(1, n / threads);
+    size_t grain = elapsed > 0 ? static_cast<size_t>(static_cast<double>(k) * GRAIN_TARGET_NS / elapsed) : n;
+    size_t upper = (n - done) / (threads * 4);
+    return std::max<size_t>(1, std::min(grain, upper));
+}
+
+// ---------------------------------------------------------------- 算法
+
+template<typename RandomIt, typename Func>
+void parallel_for_each(RandomIt first, RandomIt last, Func f, work_stealing_pool& pool = default_pool())
+{
+    const size_t n = std::distance(first, last);
+    auto body = [first, &f](size_t lo, size_t hi) {
+        std::for_each(first + lo, first + hi, f);
+        return true;
+    };
+    size_t done;
+    size_t grain = detect_grain(n, pool.size(), body, done);
+    if (done < n)
+        parallel_range(pool, done, n, grain, body);
+}
+
+// reduce(init, transform(x0), transform(x1), ...)，reduce 需满足结合律，不要求交换律
+template<typename RandomIt, typename T, typename Reduce, typename Transform>
+T parallel_transform_reduce(RandomIt first, RandomIt last, T init, Reduce reduce, Transform transform,
+                            work_stealing_pool& pool = default_pool())
+{
+    const size_t n = std::distance(first, last);
+    size_t done;
+    size_t grain = detect_grain(n, pool.size(), [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i)
+            init = reduce(std::move(init), transform(first[i]));
+        return true;
+    }, done);
+    if (done == n)
+        return init;
+    auto leaf = [first, &reduce, &transform](size_t lo, size_t hi) {
+        T acc = transform(first[lo]);
+        for (size_t i = lo + 1; i < hi; ++i)
+            acc = reduce(std::move(acc), transform(first[i]));
+        return acc;
+    };
+    return reduce(std::move(init), parallel_reduce_range<T>(pool, done, n, grain, leaf, reduce));
+}
+
+// 三趟：各块求和（并行） -> 块和做前缀（串行，块数很少） -> 各块加上前缀后扫描写出（并行）
+template<typename RandomIt, typename OutIt, typename BinaryOp>
+OutIt parallel_inclusive_scan(RandomIt first, RandomIt last, OutIt d_first, BinaryOp op,
+                              work_stealing_pool& pool = default_pool())
+{
+    typedef typename std::iterator_traits<RandomIt>::value_type T;
+    const size_t n = std::distance(first, last);
+    if (n == 0)
+        return d_first;
+
+    // 探测阶段直接串行扫描开头一段，carry 为已写出的最后一个值
+    T carry = first[0];
+    d_first[0] = carry;
+    size_t done;
+    size_t grain = detect_grain(n - 1, pool.size(), [&](size_t lo, size_t hi) {
+        for (size_t i = lo + 1; i < hi + 1; ++i)
+        {
+            carry = op(carry, first[i]);
+            d_first[i] = carry;
+        }
+        return true;
+    }, done);
+    size_t start = done + 1;
+    if (start == n)
+        return d_first + n;
+
+    const size_t blocks = (n - start + grain - 1) / grain;
+    std::vector<padded<T>> sums(blocks);
+    auto block_lo = [=](size_t b) { return start + b * grain; };
+    auto block_hi = [=](size_t b) { return std::min(n, start + (b + 1) * grain); };
+
+    parallel_range(pool, 0, blocks, 1, [&](size_t lo, size_t hi) {
+        for (size_t b = lo; b < hi; ++b)
+        {
+            T acc = first[block_lo(b)];
+            for (size_t i = block_lo(b) + 1; i < block_hi(b); ++i)
+                acc = op(acc, first[i]);
+            sums[b].value = acc;
+        }
+    });
+    for (size_t b = 0; b < blocks; ++b)
+    {
+        T prefix = carry;
+        carry = op(carry, sums[b].value);
+        sums[b].value = prefix;     // 改写为本块之前所有元素的前缀
+    }
+    parallel_range(pool, 0, blocks, 1, [&](size_t lo, size_t hi) {
+        for (size_t b = lo; b < hi; ++b)
+        {
+            T acc = sums[b].value;
+            for (size_t i = block_lo(b); i < block_hi(b); ++i)
+            {
+                acc = op(acc, first[i]);
+                d_first[i] = acc;
+            }
+        }
+    });
+    return d_first + n;
+}
+
+template<typename RandomIt, typename OutIt>
+OutIt parallel_inclusive_scan(RandomIt first, RandomIt last, OutIt d_first, work_stealing_pool& pool = default_pool())
+{
+    return parallel_inclusive_scan(first, last, d_first, std::plus<typename std::iterator_traits<RandomIt>::value_type>(), pool);
+}
+
+// 并行快速排序：三数取中做枢轴，分成 < = > 三段，左段提交给线程池，右段本线程继续
+template<typename RandomIt, typename Compare>
+void parallel_sort_impl(work_stealing_pool& pool, RandomIt first, RandomIt last, const Compare& comp, size_t cutoff)
+{
+    if (static_cast<size_t>(last - first) > cutoff)
+    {
+        RandomIt mid = first + (last - first) / 2;
+        auto a = *first, b = *mid, c = *(last - 1);
+        auto pivot = comp(a, b) ? (comp(b, c) ? b : (comp(a, c) ? c : a)) : (comp(a, c) ? a : (comp(b, c) ? c : b));
+        RandomIt lt = std::partition(first, last, [&](const decltype(pivot)& x) { return comp(x, pivot); });
+        RandomIt gt = std::partition(lt, last, [&](const decltype(pivot)& x) { return !comp(pivot, x); });
+        std::future<void> left = pool.submit([&pool, first, lt, &comp, cutoff]{ parallel_sort_impl(pool, first, lt, comp, cutoff); });
+        task_join_guard<void> guard{pool, left};
+        parallel_sort_impl(pool, gt, last, comp, cutoff);
+        pool.wait(left);
+        return;
+    }
+    std::sort(first, last, comp);
+}
+
+template<typename RandomIt, typename Compare>
+void parallel_sort(RandomIt first, RandomIt last, Compare comp, work_stealing_pool& pool = default_pool())
+{
+    const size_t n = std::distance(first, last);
+    size_t cutoff = std::max(SORT_MIN_GRAIN, n / (pool.size() * 8));
+    parallel_sort_impl(pool, first, last, comp, cutoff);
+}
+
+template<typename RandomIt>
+void parallel_sort(RandomIt first, RandomIt last, work_stealing_pool& pool = default_pool())
+{
+    parallel_sort(first, last, std::less<typename std::iterator_traits<RandomIt>::value_type>(), pool);
+}
+
+// 返回第一个满足 pred 的元素（与 std::find_if 相同）。已找到的最小下标记在 found 里，
+// 下标更大的块不再检查，正在检查的块每 FIND_CHECK_STRIDE 个元素看一次 found，提前退出
+template<typename RandomIt, typename Pred>
+RandomIt parallel_find_if(RandomIt first, RandomIt last, Pred pred, work_stealing_pool& pool = default_pool())
+{
+    const size_t FIND_CHECK_STRIDE = 256;
+    const size_t n = std::distance(first, last);
+    padded<std::atomic<size_t>> found;
+    found.value.store(n);
+
+    auto record = [&found](size_t i) {
+        size_t cur = found.value.load();
+        while (i < cur && !found.value.compare_exchange_weak(cur, i))
+            ;
+    };
+    size_t done;
+    size_t grain = detect_grain(n, pool.size(), [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i)
+        {
+            if (pred(first[i]))
+            {
+                record(i);
+                return false;
+            }
+        }
+        return true;
+    }, done);
+    if (found.value.load() < n || done == n)
+        return first + found.value.load();
+
+    parallel_range(pool, done, n, grain, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi && i < found.value.load(std::memory_order_relaxed); i += FIND_CHECK_STRIDE)
+        {
+            size_t end = std::min(hi, i + FIND_CHECK_STRIDE);
+            for (size_t j = i; j < end; ++j)
+            {
+                if (pred(first[j]))
+                {
+                    record(j);
+                    return;
+                }
+            }
+        }
+    });
+    return first + found.value.load();
+}
+
+#endif
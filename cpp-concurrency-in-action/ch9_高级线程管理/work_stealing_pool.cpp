@@ -0,0 +1,87 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+
+#include "work_stealing_pool.h"
+
+using namespace std;
+
+/*
+    work_stealing_pool 的用法和开销对比
+    - 每个小任务新建一个线程（joining_thread 的做法）与提交到线程池；
+    - 工作线程内部递归拆分任务，wait() 在等待子任务时帮忙执行其他任务；
+    - submit_then 的续延在同一个工作线程上执行。
+*/
+
+const int SMALL_TASKS = 20000;
+
+long small_work(int i)
+{
+    long s = 0;
+    for (int k = 0; k < 100; ++k)
+        s += (i ^ k);
+    return s;
+}
+
+double bench_thread_per_task()
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<long> results(SMALL_TASKS);
+    for (int i = 0; i < SMALL_TASKS; ++i)
+    {
+        std::thread t([&results, i]{ results[i] = small_work(i); });
+        t.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double bench_pool(work_stealing_pool& pool)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::future<long>> results;
+    results.reserve(SMALL_TASKS);
+    for (int i = 0; i < SMALL_TASKS; ++i)
+        results.push_back(pool.submit([i]{ return small_work(i); }));
+    for (auto& f : results)
+        f.get();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 任务内部再提交子任务：一半压入本地队列（可被窃取），另一半自己算
+long fib(work_stealing_pool& pool, int n)
+{
+    if (n < 16)
+        return n < 2 ? n : fib(pool, n - 1) + fib(pool, n - 2);
+    std::future<long> left = pool.submit([&pool, n]{ return fib(pool, n - 1); });
+    long right = fib(pool, n - 2);
+    return pool.wait(left) + right;
+}
+
+void f()
+{
+    work_stealing_pool pool;
+    cout << "pool threads: " << pool.size() << endl;
+
+    std::future<std::string> r = pool.submit_then(
+        []{ return std::this_thread::get_id(); },
+        [](std::thread::id producer) {
+            return std::string(producer == std::this_thread::get_id() ? "same" : "another") + " worker";
+        });
+    cout << "continuation ran on " << r.get() << endl;
+
+    std::future<long> fut = pool.submit([&pool]{ return fib(pool, 30); });
+    cout << "fib(30) = " << fut.get() << endl;
+
+    cout << SMALL_TASKS << " small tasks, thread per task: " << bench_thread_per_task() << " s" << endl;
+    cout << SMALL_TASKS << " small tasks, pool: " << bench_pool(pool) << " s" << endl;
+}
+
+// 编译: g++ -std=c++17 -O2 -pthread work_stealing_pool.cpp -o work_stealing_pool
+int main(int argc, char* argv[])
+{
+    f();
+    cout << "Main thread..." << endl;
+    return 0;
+}
@@ -0,0 +1,425 @@
+#ifndef __WORK_STEALING_POOL_H__
+#define __WORK_STEALING_POOL_H__
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <type_traits>
+#include <cstdint>
+#include <functional>
+
+/*
+    工作窃取线程池
+
+    parallel_accumulate 每次调用都新建 std::thread，epolloneshot 每个可读事件都 pthread_create 一次，
+    joining_thread/scoped_thread 也只是对裸线程的包装。这里的线程池在构造时创建固定数量的工作线程，之后提交任务不再创建线程：
+    - 每个工作线程有自己的 Chase-Lev 双端队列：本线程从底部 push/pop（后进先出，缓存最热），
+      空闲的线程从其他队列的顶部窃取（先进先出，偷到的通常是较大的子任务），双方只在队列只剩一个元素时才竞争同一个 CAS；
+    - 非工作线程提交的任务进入一个加锁的全局队列，工作线程本地队列为空时先取全局队列，再去窃取；
+    - submit() 返回 std::future；submit_then(f, c) 在 f 完成后把续延 c(f 的结果) 压入同一个工作线程的本地队列，
+      通常紧接着由这个线程执行，f 的结果还在它的缓存里；
+    - 在工作线程里等待 future 时用 wait(future)：等待期间执行其他待处理任务，递归拆分任务不会因为所有线程都在等待而死锁；
+    - 找不到任务的线程短暂自旋后睡在条件变量上，提交任务时只有存在睡眠线程才加锁 notify。
+*/
+
+// ---------------------------------------------------------------- 任务
+
+class pool_task
+{
+public:
+    virtual ~pool_task() {}
+    virtual void run() = 0;
+};
+
+template<typename F>
+class pool_task_impl : public pool_task
+{
+    F f;
+
+public:
+    explicit pool_task_impl(F&& f_) : f(std::move(f_)) {}
+    void run() override { f(); }
+};
+
+template<typename F>
+pool_task* make_pool_task(F&& f)
+{
+    return new pool_task_impl<typename std::decay<F>::type>(std::forward<F>(f));
+}
+
+// ---------------------------------------------------------------- Chase-Lev 双端队列
+
+// 所有者线程调用 push/pop，其他线程只调用 steal。内存序按 Lê 等人的 C11 版本（PPoPP'13）
+template<typename T>
+class ws_deque
+{
+private:
+    struct ring
+    {
+        int64_t capacity;
+        std::atomic<T>* slots;
+
+        explicit ring(int64_t cap) : capacity(cap), slots(new std::atomic<T>[cap]) {}
+        ~ring() { delete[] slots; }
+        T get(int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t i, T v) { slots[i & (capacity - 1)].store(v, std::memory_order_relaxed); }
+    };
+
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    std::atomic<ring*> array;
+    std::vector<ring*> retired;     // 扩容前的旧数组：窃取者可能还在读，队列析构时才释放
+
+    ring* grow(ring* old, int64_t b, int64_t t)
+    {
+        ring* r = new ring(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i)
+            r->put(i, old->get(i));
+        retired.push_back(old);
+        array.store(r, std::memory_order_release);
+        return r;
+    }
+
+public:
+    explicit ws_deque(int64_t capacity = 256) : top(0), bottom(0), array(new ring(capacity)) {}
+
+    ~ws_deque()
+    {
+        delete array.load();
+        for (ring* r : retired)
+            delete r;
+    }
+
+    ws_deque(const ws_deque&) = delete;
+    ws_deque& operator=(const ws_deque&) = delete;
+
+    void push(T v)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        ring* a = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1)
+            a = grow(a, b, t);
+        a->put(b, v);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    bool pop(T& v)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        ring* a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);   // 队列为空
+            return false;
+        }
+        v = a->get(b);
+        if (t == b)
+        {
+            // 只剩最后一个元素，和窃取者竞争
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    bool steal(T& v)
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+        ring* a = array.load(std::memory_order_acquire);
+        v = a->get(t);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    bool empty() const
+    {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+};
+
+// ---------------------------------------------------------------- 线程池
+
+class work_stealing_pool
+{
+private:
+    static const int SPIN_ROUNDS = 64;     // 睡眠前重新扫描所有队列的次数
+
+    struct alignas(64) worker
+    {
+        ws_deque<pool_task*> tasks;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<worker>> workers;
+
+    std::mutex global_mutex;
+    std::deque<pool_task*> global_tasks;
+    std::atomic<size_t> global_count;
+
+    alignas(64) std::atomic<uint64_t> epoch;    // 每提交一个任务加一，睡眠线程据此判断是否有新任务
+    std::atomic<int> sleepers;
+    std::atomic<bool> done;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cond;
+
+    // 当前线程所属的线程池和下标，非工作线程为 nullptr
+    static work_stealing_pool*& current_pool()
+    {
+        thread_local static work_stealing_pool* pool = nullptr;
+        return pool;
+    }
+    static size_t& current_index()
+    {
+        thread_local static size_t index = 0;
+        return index;
+    }
+
+    static unsigned next_random()
+    {
+        thread_local static unsigned x = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x;
+    }
+
+    void push_task(pool_task* t)
+    {
+        if (current_pool() == this)
+        {
+            workers[current_index()]->tasks.push(t);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lk(global_mutex);
+            global_tasks.push_back(t);
+            global_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        ++epoch;
+        if (sleepers.load() > 0)
+        {
+            std::lock_guard<std::mutex> lk(sleep_mutex);
+            sleep_cond.notify_one();
+        }
+    }
+
+    bool pop_global(pool_task*& t)
+    {
+        if (global_count.load(std::memory_order_relaxed) == 0)
+            return false;
+        std::lock_guard<std::mutex> lk(global_mutex);
+        if (global_tasks.empty())
+            return false;
+        t = global_tasks.front();
+        global_tasks.pop_front();
+        global_count.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 从随机的一个工作线程开始依次尝试窃取
+    bool steal(pool_task*& t)
+    {
+        size_t n = workers.size();
+        size_t self = current_pool() == this ? current_index() : n;
+        size_t start = next_random() % n;
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t victim = (start + i) % n;
+            if (victim != self && workers[victim]->tasks.steal(t))
+                return true;
+        }
+        return false;
+    }
+
+    bool find_task(pool_task*& t)
+    {
+        if (current_pool() == this && workers[current_index()]->tasks.pop(t))
+            return true;
+        return pop_global(t) || steal(t);
+    }
+
+    void worker_loop(size_t index)
+    {
+        current_pool() = this;
+        current_index() = index;
+        pool_task* t;
+        while (true)
+        {
+            uint64_t seen = epoch.load();
+            bool found = false;
+            for (int i = 0; i < SPIN_ROUNDS && !found; ++i)
+            {
+                found = find_task(t);
+                if (!found)
+                    std::this_thread::yield();
+            }
+            if (found)
+            {
+                t->run();
+                delete t;
+                continue;
+            }
+            if (done.load())
+                break;
+            // 先读 epoch 再扫描：扫描之后提交的任务一定会改变 epoch，下面的等待不会错过
+            std::unique_lock<std::mutex> lk(sleep_mutex);
+            ++sleepers;
+            sleep_cond.wait(lk, [&]{ return epoch.load() != seen || done.load(); });
+            --sleepers;
+        }
+    }
+
+public:
+    explicit work_stealing_pool(unsigned threads = std::thread::hardware_concurrency())
+        : global_count(0), epoch(0), sleepers(0), done(false)
+    {
+        if (threads == 0)
+            threads = 2;
+        for (unsigned i = 0; i < threads; ++i)
+            workers.emplace_back(new worker);
+        try
+        {
+            for (unsigned i = 0; i < threads; ++i)
+                workers[i]->thread = std::thread(&work_stealing_pool::worker_loop, this, i);
+        }
+        catch (...)
+        {
+            shutdown();
+            throw;
+        }
+    }
+
+    // 等待已提交的任务全部执行完再退出
+    ~work_stealing_pool()
+    {
+        shutdown();
+    }
+
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    template<typename F>
+    auto submit(F f) -> std::future<decltype(f())>
+    {
+        typedef decltype(f()) result_type;
+        std::packaged_task<result_type()> task(std::move(f));
+        std::future<result_type> res = task.get_future();
+        push_task(make_pool_task(std::move(task)));
+        return res;
+    }
+
+    // f 执行完后，把 c(f()) 作为续延压入同一个工作线程的本地队列；返回续延结果的 future
+    template<typename F, typename C>
+    auto submit_then(F f, C c) -> std::future<decltype(c(f()))>
+    {
+        typedef decltype(c(f())) result_type;
+        auto promise = std::make_shared<std::promise<result_type>>();
+        std::future<result_type> res = promise->get_future();
+        push_task(make_pool_task([this, f, c, promise]() mutable {
+            try
+            {
+                auto value = f();
+                push_task(make_pool_task([c, promise, value]() mutable {
+                    set_promise(*promise, c, std::move(value));
+                }));
+            }
+            catch (...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        }));
+        return res;
+    }
+
+    // 取出并执行一个待处理任务，没有任务时让出 CPU
+    void run_pending_task()
+    {
+        pool_task* t;
+        if (find_task(t))
+        {
+            t->run();
+            delete t;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // 等待 future 就绪，期间帮忙执行其他任务，然后返回结果
+    template<typename R>
+    R wait(std::future<R>& f)
+    {
+        while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            run_pending_task();
+        return f.get();
+    }
+
+private:
+    template<typename C, typename V>
+    static void set_promise(std::promise<void>& p, C& c, V&& v)
+    {
+        try
+        {
+            c(std::forward<V>(v));
+            p.set_value();
+        }
+        catch (...)
+        {
+            p.set_exception(std::current_exception());
+        }
+    }
+
+    template<typename R, typename C, typename V>
+    static void set_promise(std::promise<R>& p, C& c, V&& v)
+    {
+        try
+        {
+            p.set_value(c(std::forward<V>(v)));
+        }
+        catch (...)
+        {
+            p.set_exception(std::current_exception());
+        }
+    }
+
+    void shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lk(sleep_mutex);
+            done.store(true);
+        }
+        sleep_cond.notify_all();
+        for (auto& w : workers)
+        {
+            if (w->thread.joinable())
+                w->thread.join();
+        }
+    }
+};
+
+// 进程内共享的默认线程池，第一次使用时创建
+inline work_stealing_pool& default_pool()
+{
+    static work_stealing_pool pool;
+    return pool;
+}
+
+#endif
@@ -19,11 +19,26 @@
  * 即使是同一个端口, TCP 和 UDP 请求也需要分别创建不同的 socket，即流式 socket 和 数据报 socket。
  * 
  * 同时处理一个端口上的 TCP 和 UDP 请求的 回射服务器
+ *
+ * UDP 有两种处理方式（第三个参数选择）：
+ *   single: 每个数据报一次 recvfrom + 一次 sendto；
+ *   batch:  用 recvmmsg 一次最多取 UDP_BATCH_SIZE 个数据报到预先分配的缓冲区池，再用一次 sendmmsg 全部回射，
+ *           每批只需两次系统调用。可用 udp_echo_bench 对比两种方式的每秒包数。
+ * 两种方式都只回射实际收到的长度，并且在 ET 模式下一直读到 EAGAIN。
 */
 
 #define MAX_EVENT_NUMBER 1024
 #define TCP_BUFFER_SIZE 512
 #define UDP_BUFFER_SIZE 1024
+#define UDP_BATCH_SIZE 64
+
+// batch 模式的缓冲区池，启动时分配一次，之后每批复用
+struct UdpBatch {
+    char bufs[UDP_BATCH_SIZE][UDP_BUFFER_SIZE];
+    struct iovec iovs[UDP_BATCH_SIZE];
+    struct sockaddr_in addrs[UDP_BATCH_SIZE];
+    struct mmsghdr msgs[UDP_BATCH_SIZE];
+};
 
 int setnonblocking(int fd) {
     int old_option = fcntl(fd, F_GETFL);
@@ -40,14 +55,65 @@ void addfd(int epollfd, int fd) {
     setnonblocking(fd);
 }
 
+// 逐个处理：每个数据报一次 recvfrom 和一次 sendto
+void udp_echo_single(int udpfd) {
+    char buf[UDP_BUFFER_SIZE];
+    while (1) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int ret = recvfrom(udpfd, buf, UDP_BUFFER_SIZE, 0, (struct sockaddr*)&client_addr, &client_len);
+        if (ret < 0) {
+            break;  // EAGAIN：ET 模式下已读空
+        }
+        sendto(udpfd, buf, ret, 0, (struct sockaddr*)&client_addr, client_len);
+    }
+}
+
+// 批量处理：recvmmsg 一次取一批，sendmmsg 一次发回，iov_len 设为每个数据报实际收到的长度
+void udp_echo_batch(int udpfd, UdpBatch *batch) {
+    while (1) {
+        for (int i = 0; i < UDP_BATCH_SIZE; ++i) {
+            batch->iovs[i].iov_base = batch->bufs[i];
+            batch->iovs[i].iov_len = UDP_BUFFER_SIZE;
+            struct msghdr &hdr = batch->msgs[i].msg_hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_name = &batch->addrs[i];
+            hdr.msg_namelen = sizeof(batch->addrs[i]);
+            hdr.msg_iov = &batch->iovs[i];
+            hdr.msg_iovlen = 1;
+        }
+        int n = recvmmsg(udpfd, batch->msgs, UDP_BATCH_SIZE, MSG_DONTWAIT, NULL);
+        if (n <= 0) {
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            batch->iovs[i].iov_len = batch->msgs[i].msg_len;
+        }
+        // sendmmsg 可能只发出一部分，剩下的继续发；发送缓冲区满时丢弃（UDP 本身不保证送达）
+        int sent = 0;
+        while (sent < n) {
+            int ret = sendmmsg(udpfd, batch->msgs + sent, n - sent, 0);
+            if (ret <= 0) {
+                break;
+            }
+            sent += ret;
+        }
+        if (n < UDP_BATCH_SIZE) {
+            break;
+        }
+    }
+}
+
 int main(int argc, char const *argv[]) {
      if (argc <= 2) {
-        std::cout << "usage : " << basename(argv[0]) << " ip_address port_number" << std::endl;
+        std::cout << "usage : " << basename(argv[0]) << " ip_address port_number [single|batch]" << std::endl;
         return 1;
     }
 
     const char *ip = argv[1];
     int port = atoi(argv[2]);
+    bool batch_mode = argc > 3 && strcmp(argv[3], "batch") == 0;
+    UdpBatch *batch = batch_mode ? new UdpBatch : NULL;
 
     int ret = 0;
     struct sockaddr_in addr;
@@ -100,14 +166,10 @@ int main(int argc, char const *argv[]) {
                 int connfd = accept(listenfd, (struct sockaddr*)&client_addr, &client_len);
                 addfd(epollfd, connfd);
             } else if (sockfd == udpfd) {
-                char buf[UDP_BUFFER_SIZE];
-                memset(buf, 0, sizeof(buf));
-                struct sockaddr_in client_addr;
-                socklen_t client_len = sizeof(client_addr);
-                ret = recvfrom(udpfd, buf, UDP_BUFFER_SIZE - 1, 0, (struct sockaddr*)&client_addr, &client_len);
-
-                if (ret > 0) {
-                    sendto(udpfd, buf, UDP_BUFFER_SIZE - 1, 0, (struct  sockaddr*)&client_addr, client_len);
+                if (batch_mode) {
+                    udp_echo_batch(udpfd, batch);
+                } else {
+                    udp_echo_single(udpfd);
                 }
             } else if (events[i].events & EPOLLIN) {
                 char buf[UDP_BUFFER_SIZE];
@@ -133,6 +195,7 @@ int main(int argc, char const *argv[]) {
     }
     
     close(listenfd);
+    delete batch;
     return 0;
 }
 
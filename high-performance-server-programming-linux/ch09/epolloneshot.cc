@@ -9,9 +9,10 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <sys/epoll.h>
-#include <pthread.h>
 #include <iostream>
 
+#include "../../cpp-concurrency-in-action/ch9_高级线程管理/work_stealing_pool.h"
+
 /**
  * 即使是 ET 模式，一个 socket 上的事件还是可能被触发多次。这在并发程序中引起一个问题：
  * 比如一个线程在读物完某个 socket 上的数据后开始处理这些数据，而在数据的处理过程中该 socket 上又有新的数据可读（EPOLLIN再次被触发），此时
@@ -25,14 +26,14 @@
  *  其 EPOLLIN 事件能被触发，进而让其他线程有机会继续处理这个 socket.
  * 
  * 使用 EPOLLONESHOT 事件
+ *
+ * 可读事件交给一个固定大小的工作窃取线程池处理，不再为每个事件 pthread_create 一个线程。
+ * EPOLLONESHOT 保证同一个 socket 同一时刻只在一个任务里被处理；线程池满负荷时，新的事件排队等待空闲的工作线程。
 */
 
 #define MAX_EVENT_NUMBER 1024
 #define BUFFER_SIZE 5
-struct fds {
-    int epollfd;
-    int sockfd;
-};
+#define WORKER_THREADS 4
 
 // 将文件描述符设置为非阻塞的
 int setnoblocking(int fd) {
@@ -63,11 +64,9 @@ void reset_oneshot(int epollfd, int fd) {
     epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event);
 }
 
-// 工作线程
-void* worker(void* arg) {
-    int sockfd = ((fds*) arg)->sockfd;
-    int epollfd = ((fds*) arg)->epollfd;
-    std::cout << "start new thread to receive data on fd = " << sockfd << std::endl;
+// 线程池中的任务
+void worker(int epollfd, int sockfd) {
+    std::cout << "start new task on thread " << std::this_thread::get_id() << " to receive data on fd = " << sockfd << std::endl;
     char buf[BUFFER_SIZE];
     memset(buf, 0, BUFFER_SIZE);
     
@@ -94,7 +93,7 @@ void* worker(void* arg) {
         }
     }
     std::cout << "fd = " << sockfd << ", content = " << str << std::endl;
-    std::cout << "end thread receiving data on fd = " << sockfd << std::endl;
+    std::cout << "end task receiving data on fd = " << sockfd << std::endl;
 }
 
 int main(int argc, char const *argv[]) {
@@ -129,6 +128,9 @@ int main(int argc, char const *argv[]) {
     // 因为后续的客户连接请求将不在触发 listenfd 上的 EPOLLIN 事件
     addfd(epollfd, listenfd, false);
 
+    // 任务里会 sleep 模拟耗时处理，线程数按并发连接数而不是 CPU 核数设置
+    work_stealing_pool pool(WORKER_THREADS);
+
     while (1) {
         // 一段超时时间内等待一组文件描述符上的事件.
         // 成功时返回就绪的文件描述符个数, 失败返回 -1 并设置 errno
@@ -148,12 +150,8 @@ int main(int argc, char const *argv[]) {
                 // 对每非监听文件描述符都注册 EPOLLONESHOT 事件
                 addfd(epollfd, connfd, true);
             } else if (events[i].events | EPOLLIN) {
-                pthread_t thread;
-                fds fds_for_new_worker;
-                fds_for_new_worker.epollfd = epollfd;
-                fds_for_new_worker.sockfd = sockfd;
-                // 新启动一个工作线程为 sockfd 服务
-                pthread_create(&thread, NULL, worker, (void*)&fds_for_new_worker);
+                // 提交一个任务为 sockfd 服务，fd 按值捕获
+                pool.submit([epollfd, sockfd] { worker(epollfd, sockfd); });
             } else {
                 std::cout << "something else happened" << std::endl;
             }
@@ -0,0 +1,117 @@
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <assert.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <time.h>
+#include <iostream>
+
+/**
+ * UDP 回射的每秒包数基准，用于对比 echo_server 的 single 和 batch 两种 UDP 处理方式：
+ *   ./echo_server 127.0.0.1 9999 single   或   ./echo_server 127.0.0.1 9999 batch
+ *   ./udp_echo_bench 127.0.0.1 9999 [秒数，默认 3] [包长，默认 64] [窗口，默认 256]
+ * 客户端始终保持 window 个请求在途（用 sendmmsg/recvmmsg 批量收发，避免客户端自己成为瓶颈），
+ * 统计每秒收到的回射包数，并检查回射长度等于发送长度。超过 100ms 没有回包时认为在途的包已丢失，重新填满窗口。
+*/
+
+#define BATCH_SIZE 64
+#define MAX_PAYLOAD 1024
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char const *argv[]) {
+    if (argc <= 2) {
+        std::cout << "usage : " << basename(argv[0]) << " ip_address port_number [seconds] [size] [window]" << std::endl;
+        return 1;
+    }
+    struct sockaddr_in addr;
+    bzero(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, argv[1], &addr.sin_addr);
+    addr.sin_port = htons(atoi(argv[2]));
+    double seconds = argc > 3 ? atof(argv[3]) : 3;
+    int size = argc > 4 ? atoi(argv[4]) : 64;
+    int window = argc > 5 ? atoi(argv[5]) : 256;
+    if (size < 1 || size > MAX_PAYLOAD) {
+        size = 64;
+    }
+
+    int sockfd = socket(PF_INET, SOCK_DGRAM, 0);
+    assert(sockfd >= 0);
+    // 已连接的 UDP socket：收发不再需要每次指定地址，也只会收到服务器的包
+    int ret = connect(sockfd, (struct sockaddr*)&addr, sizeof(addr));
+    assert(ret != -1);
+
+    static char tx_buf[MAX_PAYLOAD];
+    static char rx_bufs[BATCH_SIZE][MAX_PAYLOAD];
+    memset(tx_buf, 'x', sizeof(tx_buf));
+    struct iovec tx_iov = {tx_buf, (size_t)size};
+    struct mmsghdr tx_msgs[BATCH_SIZE], rx_msgs[BATCH_SIZE];
+    struct iovec rx_iovs[BATCH_SIZE];
+    memset(tx_msgs, 0, sizeof(tx_msgs));
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        tx_msgs[i].msg_hdr.msg_iov = &tx_iov;
+        tx_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    long received = 0, bad_len = 0, stalls = 0;
+    int outstanding = 0;
+    double start = now_sec(), last_recv = start;
+    while (now_sec() - start < seconds) {
+        while (outstanding < window) {
+            int n = window - outstanding < BATCH_SIZE ? window - outstanding : BATCH_SIZE;
+            n = sendmmsg(sockfd, tx_msgs, n, MSG_DONTWAIT);
+            if (n <= 0) {
+                break;
+            }
+            outstanding += n;
+        }
+
+        struct pollfd pfd = {sockfd, POLLIN, 0};
+        poll(&pfd, 1, 10);
+        while (1) {
+            for (int i = 0; i < BATCH_SIZE; ++i) {
+                rx_iovs[i].iov_base = rx_bufs[i];
+                rx_iovs[i].iov_len = MAX_PAYLOAD;
+                memset(&rx_msgs[i].msg_hdr, 0, sizeof(rx_msgs[i].msg_hdr));
+                rx_msgs[i].msg_hdr.msg_iov = &rx_iovs[i];
+                rx_msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int n = recvmmsg(sockfd, rx_msgs, BATCH_SIZE, MSG_DONTWAIT, NULL);
+            if (n <= 0) {
+                break;
+            }
+            for (int i = 0; i < n; ++i) {
+                if ((int)rx_msgs[i].msg_len != size) {
+                    ++bad_len;
+                }
+            }
+            received += n;
+            outstanding -= n;
+            if (outstanding < 0) {
+                outstanding = 0;
+            }
+            last_recv = now_sec();
+        }
+        if (outstanding > 0 && now_sec() - last_recv > 0.1) {
+            outstanding = 0;
+            ++stalls;
+            last_recv = now_sec();
+        }
+    }
+    double elapsed = now_sec() - start;
+
+    std::cout << received << " echoes in " << elapsed << " s: " << (long)(received / elapsed) << " packets/s, "
+              << size << " bytes each, window " << window << ", " << bad_len << " wrong-length echoes, "
+              << stalls << " stalls" << std::endl;
+    close(sockfd);
+    return bad_len == 0 ? 0 : 1;
+}
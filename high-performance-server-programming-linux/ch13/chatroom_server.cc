@@ -14,9 +14,13 @@
 #include <iostream>
 #include <functional>
 
+#include "shm_msg_ring.h"
+
 /**
  * 使用共享内存的聊天室服务器程序
  * 将所有客户 socket 连接的都缓冲设计为一块共享内存
+ * 共享内存划分为 USER_LIMIT 个 SPMC 消息环（见 shm_msg_ring.h），每个客户连接独占一个环写入，
+ * 其他子进程各自维护读游标，消息只写一次，发送时只发送消息的实际字节
 */
 
 
@@ -25,6 +29,7 @@
 #define FD_LIMIT 65535
 #define MAX_EVENT_NUMBER 1024
 #define PROCESS_LIMIT 655350
+#define SHM_SIZE (USER_LIMIT * sizeof(ShmMsgRing))
 
 
 /// 处理一个客户连接必要的数据
@@ -33,6 +38,7 @@ struct client_data {
     int connfd;             /// socket 文件描述符
     pid_t pid;              /// 处理该连接的子进程 pid
     int pipefd[2];          /// 和父进程通信的管道
+    int ring;               /// 该连接写入的消息环编号
 };
 
 static const char* g_shm_name = "/my_shm";
@@ -42,6 +48,10 @@ int listenfd;
 int shmfd;
 char* share_mem = nullptr;
 
+/// 消息环的占用情况，由父进程维护。环的编号与客户连接编号分离，
+/// 因为客户连接编号会在有连接关闭时被重新排列，而一个环在其子进程退出前只能有一个生产者
+bool g_ring_used[USER_LIMIT];
+
 /// 客户连接数组，进程使用客户连接的编号来索引该数组，即可取得相关的客户端连接数据
 client_data* g_users = nullptr;
 
@@ -101,6 +111,33 @@ void child_term_handler (int sig) {
     stop_child = true;
 }
 
+inline ShmMsgRing* get_ring(char* share_mem, int ring) {
+    return reinterpret_cast<ShmMsgRing*>(share_mem) + ring;
+}
+
+int alloc_ring() {
+    for (int i = 0; i < USER_LIMIT; ++i) {
+        if (!g_ring_used[i]) {
+            g_ring_used[i] = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// 将第 ring 个环中本进程尚未读取的消息全部发送给本进程负责的客户端
+void forward_ring(char* share_mem, int ring, RingCursor* cursor, int connfd) {
+    char buf[BUFFER_SIZE];
+    uint64_t lost = 0;
+    int len;
+    while ((len = ring_consume(get_ring(share_mem, ring), cursor, buf, sizeof(buf), &lost)) > 0) {
+        if (lost > 0) {
+            std::cout << "ring " << ring << " lost " << lost << " messages" << std::endl;
+        }
+        send(connfd, buf, len, 0);
+    }
+}
+
 /// 子进程运行的函数
 /**
  * idx 指出子进程处理的客户连接的编号
@@ -109,6 +146,14 @@ void child_term_handler (int sig) {
 */
 int run_child(int idx, client_data* g_users, char* share_mem) {
     epoll_event events[MAX_EVENT_NUMBER];
+    char buf[BUFFER_SIZE];
+    int my_ring = g_users[idx].ring;
+
+    /// 每个环一个读游标，只接收本进程启动之后的消息
+    RingCursor cursors[USER_LIMIT];
+    for (int r = 0; r < USER_LIMIT; ++r) {
+        ring_cursor_init(get_ring(share_mem, r), &cursors[r]);
+    }
 
     /// 子进程使用 IO 复用技术来同时监听两个文件描述符：客户连接 socket、与父进程通信的管道文件描述符
     int child_epollfd = epoll_create(5);
@@ -134,12 +179,9 @@ int run_child(int idx, client_data* g_users, char* share_mem) {
 
             /// 此子进程负责的客户连接有数据到达
             if ((sockfd == connfd) && (events[i].events & EPOLLIN)) {
-                memset(share_mem + idx * BUFFER_SIZE, '\0', BUFFER_SIZE);
-
-                /// 将客户数据读取到对应的读缓存中。
-                /// 该缓存是共享内存的一段，它开始于 idx * BUFFER_SIZE 处，长度为 BUFFER_SIZE 字节
-                /// 所以，每个客户连接的读缓存是共享的
-                ret = recv(connfd, share_mem + idx * BUFFER_SIZE, BUFFER_SIZE - 1, 0);
+                /// 将客户数据追加到本连接独占的消息环中。
+                /// 消息环位于共享内存，写入一次即可被所有子进程读取，已发布的消息不会被下一条消息覆盖
+                ret = recv(connfd, buf, BUFFER_SIZE, 0);
                 if (ret < 0) {
                     if (errno != EAGAIN) {
                         stop_child = true;
@@ -147,24 +189,36 @@ int run_child(int idx, client_data* g_users, char* share_mem) {
                 } else if (ret == 0) {
                     stop_child = true;
                 } else {
-                    /// 成功读取客户数据后就通知主进程（通过管道）来处理
-                    send(pipefd, reinterpret_cast<char*>(&idx), sizeof(idx), 0);
+                    ring_publish(get_ring(share_mem, my_ring), buf, ret);
+                    /// 成功写入消息环后就通知主进程（通过管道）来处理
+                    send(pipefd, reinterpret_cast<char*>(&my_ring), sizeof(my_ring), 0);
                 }
             } else if ((sockfd == pipefd) && (events[i].events | EPOLLIN)) {
-                /// 主进程通知此进程（通过管道）将第 client 个客户端的数据发送到本进程负责的客户端
-                
-                int client = 0;
-
-                /// 接收主进程发送来的数据，即 有客户数据到达的连接的编号
-                ret = recv(sockfd, reinterpret_cast<char*>(&client), sizeof(client), 0);
-                if (ret < 0) {
-                    if (errno != EAGAIN) {
+                /// 主进程通知此进程（通过管道）将其他客户端的新消息发送到本进程负责的客户端
+
+                /// 接收主进程发送来的数据，即 有新消息的环的编号。
+                /// 管道是 ET 模式，多次通知可能合并到达，所以读空管道后再扫描所有其他环
+                int rings[MAX_EVENT_NUMBER];
+                bool notified = false;
+                for (;;) {
+                    ret = recv(sockfd, reinterpret_cast<char*>(rings), sizeof(rings), 0);
+                    if (ret < 0) {
+                        if (errno != EAGAIN) {
+                            stop_child = true;
+                        }
+                        break;
+                    } else if (ret == 0) {
                         stop_child = true;
-                    } 
-                } else if (ret == 0) {
-                    stop_child = true;
-                } else {
-                    send(connfd, share_mem + client * BUFFER_SIZE, BUFFER_SIZE, 0);
+                        break;
+                    }
+                    notified = true;
+                }
+                if (notified) {
+                    for (int r = 0; r < USER_LIMIT; ++r) {
+                        if (r != my_ring) {
+                            forward_ring(share_mem, r, &cursors[r], connfd);
+                        }
+                    }
                 }
             } else {
                 continue;
@@ -230,11 +284,11 @@ int main(int argc, char const *argv[]) {
     /// 创建共享内存，作为所有客户 socket 连接的读缓存
     shmfd = shm_open(g_shm_name, O_CREAT | O_RDWR, 0666);
     assert(shmfd != -1);
-    ret = ftruncate(shmfd, USER_LIMIT * BUFFER_SIZE); /// 设置共享内存的大小
+    ret = ftruncate(shmfd, SHM_SIZE); /// 设置共享内存的大小，新建的共享内存全为 0，即所有环为空
     assert(ret != -1);
 
     /// 调用 mmap 将共享内存映射到当前进程的地址空间，返回映射区的首地址
-    share_mem = (char*)mmap(NULL, USER_LIMIT * BUFFER_SIZE
+    share_mem = (char*)mmap(NULL, SHM_SIZE
                             , PROT_READ | PROT_WRITE, MAP_SHARED, shmfd, 0);
     assert(share_mem != MAP_FAILED);
     /// 已经将共享内存映射到了当前进程地址空间，关闭共享内存的文件描述符
@@ -273,12 +327,16 @@ int main(int argc, char const *argv[]) {
                 /// 保存第 g_user_count 个客户连接的相关数据
                 g_users[g_user_count].address = client_addr;
                 g_users[g_user_count].connfd = connfd;
+                /// 环不清零：write_pos 单调递增，已存在的读游标可以直接接着读新生产者的消息
+                g_users[g_user_count].ring = alloc_ring();
+                assert(g_users[g_user_count].ring != -1);
                 /// 在主进程和子进程间建立管道，以传递必要的数据
                 ret = socketpair(PF_UNIX, SOCK_STREAM, 0, g_users[g_user_count].pipefd);
                 assert(ret != -1);
 
                 pid_t pid = fork();
                 if (pid < 0) {
+                    g_ring_used[g_users[g_user_count].ring] = false;
                     close(connfd);
                     continue;
                 } else if (pid == 0) {
@@ -289,7 +347,7 @@ int main(int argc, char const *argv[]) {
                     close(sig_pipefd[0]);
                     close(sig_pipefd[1]);
                     run_child(g_user_count, g_users, share_mem);
-                    munmap(reinterpret_cast<void*>(share_mem), USER_LIMIT * BUFFER_SIZE);
+                    munmap(reinterpret_cast<void*>(share_mem), SHM_SIZE);
                     exit(0);
                 } else {
                     /// 父进程
@@ -330,6 +388,7 @@ int main(int argc, char const *argv[]) {
                                 /// 清除第 del_user 个客户连接使用的相关数据
                                 epoll_ctl(epollfd, EPOLL_CTL_DEL, g_users[del_user].pipefd[0], 0);
                                 close(g_users[del_user].pipefd[0]);
+                                g_ring_used[g_users[del_user].ring] = false;
                                 g_users[del_user] = g_users[--g_user_count];
                                 sub_process[g_users[del_user].pid] = del_user;
                             }
@@ -362,7 +421,7 @@ int main(int argc, char const *argv[]) {
             } else if (events[i].events & EPOLLIN) {
                 /// 某个子进程想父进程写入了数据
                 int child = 0;
-                /// 读取管道数据，child 变量记录是哪个客户连接有数据到达
+                /// 读取管道数据，child 变量记录是哪个消息环有新消息
                 ret = recv(sockfd, reinterpret_cast<char*>(&child), sizeof(child), 0);
                 std::cout << "read data from child accross pipe" << std::endl;
                 if (ret == -1) {
@@ -390,8 +449,9 @@ int main(int argc, char const *argv[]) {
 
 /* 注意
     1. 编译该代码需要链接库 -lrt (real time)
-    2. 尽管使用了读缓存，但是每个子进程都只向自己所处理的客户连接所对应的那部分读缓存写数据，
-        所以使用共享内存的目的只是为了共享读。每次子进程在使用共享内存的时候无需加锁。
+    2. 尽管使用了读缓存，但是每个子进程都只向自己所处理的客户连接所对应的那个消息环写数据，
+        所以使用共享内存的目的只是为了共享读。每次子进程在使用共享内存的时候无需加锁：
+        生产者以 release 语义发布 write_pos，消费者以 acquire 语义读取，并各自保存读游标。
     3. 服务器程序在启动的时候给数组 g_users 分配了足够多的空间，十七可以存储所有可能的客户连接的相关数据。
         同样，一次性给数组 sub_process 分配的空间也足以存储所有可能的子进程相关数据。牺牲空间换时间。
 */
@@ -0,0 +1,150 @@
+#ifndef __SHM_MSG_RING_H__
+#define __SHM_MSG_RING_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+/**
+ * 共享内存中的单生产者多消费者（SPMC）消息环形缓冲区
+ *
+ * 每个客户连接对应一个环，只有处理该连接的子进程会写入（单生产者），
+ * 其他所有子进程各自维护自己的读游标（多消费者），读写双方都不加锁。
+ *
+ * 环中存放变长消息记录：[MsgHeader][data...]，按 8 字节对齐。
+ * 写位置 write_pos 是单调递增的绝对字节偏移，对 RING_BYTES 取模得到环内下标。
+ * 生产者不等待消费者：慢速消费者落后超过 RING_MAX_LAG 时视为被套圈，丢弃旧消息，并通过序列号感知到丢失。
+*/
+
+#define RING_BYTES (16 * 1024)      /// 每个环的数据区大小，必须是 2 的幂
+#define RING_ALIGN 8
+#define RING_PAD_LEN 0xFFFFFFFFu    /// 填充记录：跳到环的起始处
+/// 一次写入（含填充）最多触及 write_pos 之后 RING_BYTES / 2 字节，
+/// 所以落后不超过 RING_MAX_LAG 的读游标所指的数据一定没有被覆盖
+#define RING_MAX_LAG (RING_BYTES / 2)
+
+static_assert((RING_BYTES & (RING_BYTES - 1)) == 0, "RING_BYTES must be power of 2");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shm ring needs lock-free 64-bit atomics");
+
+/// 每条消息的头部
+struct MsgHeader {
+    uint32_t len;       /// 消息实际字节数；RING_PAD_LEN 表示填充记录
+    uint32_t reserved;
+    uint64_t seq;       /// 该环内的消息序列号，从 1 开始
+};
+
+/// 位于共享内存中的环。ftruncate 创建的共享内存全为 0，正好是环的初始状态
+struct ShmMsgRing {
+    alignas(64) std::atomic<uint64_t> write_pos;   /// 已发布的写位置（生产者 release，消费者 acquire）
+    uint64_t next_seq;                              /// 仅生产者访问
+    alignas(64) char data[RING_BYTES];
+};
+
+inline uint64_t ring_align(uint64_t n) {
+    return (n + RING_ALIGN - 1) & ~static_cast<uint64_t>(RING_ALIGN - 1);
+}
+
+/// 单条消息的最大长度：记录不超过 1/4 个环，加上填充也不超过半个环
+inline uint32_t ring_max_msg() {
+    return RING_BYTES / 4 - sizeof(MsgHeader);
+}
+
+/**
+ * 生产者：写入一条消息，只写一次，所有消费者共享
+ * 返回该消息的序列号；消息过长返回 0
+*/
+inline uint64_t ring_publish(ShmMsgRing* ring, const char* msg, uint32_t len) {
+    if (len > ring_max_msg()) {
+        return 0;
+    }
+    uint64_t pos = ring->write_pos.load(std::memory_order_relaxed);
+    uint64_t need = ring_align(sizeof(MsgHeader) + len);
+    uint64_t off = pos & (RING_BYTES - 1);
+
+    /// 尾部剩余空间不足以放下整条记录，写入填充记录后从环首开始
+    if (off + need > RING_BYTES) {
+        if (RING_BYTES - off >= sizeof(MsgHeader)) {
+            MsgHeader pad = {RING_PAD_LEN, 0, 0};
+            memcpy(ring->data + off, &pad, sizeof(pad));
+        }
+        pos += RING_BYTES - off;
+        off = 0;
+    }
+
+    MsgHeader hdr = {len, 0, ++ring->next_seq};
+    memcpy(ring->data + off, &hdr, sizeof(hdr));
+    memcpy(ring->data + off + sizeof(hdr), msg, len);
+
+    /// 发布：消费者 acquire 读到新的 write_pos 后，一定能看到上面写入的内容
+    ring->write_pos.store(pos + need, std::memory_order_release);
+    return hdr.seq;
+}
+
+/// 消费者的私有读游标，保存在各自进程的普通内存中
+struct RingCursor {
+    uint64_t pos;
+    uint64_t last_seq;
+};
+
+/// 新加入的消费者只接收加入之后的消息
+inline void ring_cursor_init(const ShmMsgRing* ring, RingCursor* cur) {
+    cur->pos = ring->write_pos.load(std::memory_order_acquire);
+    cur->last_seq = 0;
+}
+
+/**
+ * 消费者：读取下一条消息到 buf（容量 buf_len），返回消息长度
+ * 没有新消息返回 0；lost 返回因被套圈而丢失的消息条数
+*/
+inline int ring_consume(const ShmMsgRing* ring, RingCursor* cur, char* buf, uint32_t buf_len, uint64_t* lost) {
+    *lost = 0;
+    for (;;) {
+        uint64_t head = ring->write_pos.load(std::memory_order_acquire);
+        if (cur->pos == head) {
+            return 0;
+        }
+        /// 生产者可能已经覆盖了游标所在位置，跳到最新位置，丢弃旧消息
+        if (head - cur->pos > RING_MAX_LAG) {
+            cur->pos = head;
+            continue;
+        }
+
+        uint64_t off = cur->pos & (RING_BYTES - 1);
+        if (RING_BYTES - off < sizeof(MsgHeader)) {
+            cur->pos += RING_BYTES - off;
+            continue;
+        }
+
+        MsgHeader hdr;
+        memcpy(&hdr, ring->data + off, sizeof(hdr));
+        if (hdr.len == RING_PAD_LEN) {
+            cur->pos += RING_BYTES - off;
+            continue;
+        }
+
+        uint32_t n = hdr.len < buf_len ? hdr.len : buf_len;
+        if (off + sizeof(hdr) + n > RING_BYTES) {
+            /// 头部已被覆盖成无效数据
+            cur->pos = ring->write_pos.load(std::memory_order_acquire);
+            continue;
+        }
+        memcpy(buf, ring->data + off + sizeof(hdr), n);
+
+        /// 拷贝完成后再检查一次：期间若被生产者套圈，则拷贝出的数据可能已损坏，丢弃重读
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t head_after = ring->write_pos.load(std::memory_order_relaxed);
+        if (head_after - cur->pos > RING_MAX_LAG) {
+            cur->pos = head_after;
+            continue;
+        }
+
+        if (cur->last_seq != 0 && hdr.seq > cur->last_seq + 1) {
+            *lost += hdr.seq - cur->last_seq - 1;
+        }
+        cur->last_seq = hdr.seq;
+        cur->pos += ring_align(sizeof(hdr) + hdr.len);
+        return static_cast<int>(n);
+    }
+}
+
+#endif